@@ -0,0 +1,807 @@
+#include "Chess.hpp"
+#include <cstring>
+#include <sstream>
+
+namespace Chess {
+    const char* STARTFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    namespace {
+        const char* PIECES = "PNBRQKpnbrqk";
+
+        //Material in the middlegame and the endgame, the king's is left out since both sides always have one
+        const int MIDDLEGAME[6] = { 100, 320, 330, 500, 900, 0 };
+        const int ENDGAME[6] = { 120, 300, 320, 530, 950, 0 };
+        const int PHASE[6] = { 0, 1, 1, 2, 4, 0 };
+
+        //Square bonuses for white pieces as the board is drawn, a8 first. Black reads them mirrored.
+        //The king and pawns get a second table for when most pieces are off
+        const int PAWN[64] = {
+             0,   0,   0,   0,   0,   0,   0,   0,
+            50,  50,  50,  50,  50,  50,  50,  50,
+            10,  10,  20,  30,  30,  20,  10,  10,
+             5,   5,  10,  25,  25,  10,   5,   5,
+             0,   0,   0,  20,  20,   0,   0,   0,
+             5,  -5, -10,   0,   0, -10,  -5,   5,
+             5,  10,  10, -20, -20,  10,  10,   5,
+             0,   0,   0,   0,   0,   0,   0,   0
+        };
+
+        const int PAWN_ENDGAME[64] = {
+             0,   0,   0,   0,   0,   0,   0,   0,
+            80,  80,  80,  80,  80,  80,  80,  80,
+            50,  50,  50,  50,  50,  50,  50,  50,
+            30,  30,  30,  30,  30,  30,  30,  30,
+            15,  15,  15,  15,  15,  15,  15,  15,
+             5,   5,   5,   5,   5,   5,   5,   5,
+             0,   0,   0,   0,   0,   0,   0,   0,
+             0,   0,   0,   0,   0,   0,   0,   0
+        };
+
+        const int KNIGHT[64] = {
+           -50, -40, -30, -30, -30, -30, -40, -50,
+           -40, -20,   0,   0,   0,   0, -20, -40,
+           -30,   0,  10,  15,  15,  10,   0, -30,
+           -30,   5,  15,  20,  20,  15,   5, -30,
+           -30,   0,  15,  20,  20,  15,   0, -30,
+           -30,   5,  10,  15,  15,  10,   5, -30,
+           -40, -20,   0,   5,   5,   0, -20, -40,
+           -50, -40, -30, -30, -30, -30, -40, -50
+        };
+
+        const int BISHOP[64] = {
+           -20, -10, -10, -10, -10, -10, -10, -20,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -10,   0,   5,  10,  10,   5,   0, -10,
+           -10,   5,   5,  10,  10,   5,   5, -10,
+           -10,   0,  10,  10,  10,  10,   0, -10,
+           -10,  10,  10,  10,  10,  10,  10, -10,
+           -10,   5,   0,   0,   0,   0,   5, -10,
+           -20, -10, -10, -10, -10, -10, -10, -20
+        };
+
+        const int ROOK[64] = {
+             0,   0,   0,   0,   0,   0,   0,   0,
+             5,  10,  10,  10,  10,  10,  10,   5,
+            -5,   0,   0,   0,   0,   0,   0,  -5,
+            -5,   0,   0,   0,   0,   0,   0,  -5,
+            -5,   0,   0,   0,   0,   0,   0,  -5,
+            -5,   0,   0,   0,   0,   0,   0,  -5,
+            -5,   0,   0,   0,   0,   0,   0,  -5,
+             0,   0,   0,   5,   5,   0,   0,   0
+        };
+
+        const int QUEEN[64] = {
+           -20, -10, -10,  -5,  -5, -10, -10, -20,
+           -10,   0,   0,   0,   0,   0,   0, -10,
+           -10,   0,   5,   5,   5,   5,   0, -10,
+            -5,   0,   5,   5,   5,   5,   0,  -5,
+             0,   0,   5,   5,   5,   5,   0,  -5,
+           -10,   5,   5,   5,   5,   5,   0, -10,
+           -10,   0,   5,   0,   0,   0,   0, -10,
+           -20, -10, -10,  -5,  -5, -10, -10, -20
+        };
+
+        const int KING[64] = {
+           -30, -40, -40, -50, -50, -40, -40, -30,
+           -30, -40, -40, -50, -50, -40, -40, -30,
+           -30, -40, -40, -50, -50, -40, -40, -30,
+           -30, -40, -40, -50, -50, -40, -40, -30,
+           -20, -30, -30, -40, -40, -30, -30, -20,
+           -10, -20, -20, -20, -20, -20, -20, -10,
+            20,  20,   0,   0,   0,   0,  20,  20,
+            20,  30,  10,   0,   0,  10,  30,  20
+        };
+
+        const int KING_ENDGAME[64] = {
+           -50, -40, -30, -20, -20, -30, -40, -50,
+           -30, -20, -10,   0,   0, -10, -20, -30,
+           -30, -10,  20,  30,  30,  20, -10, -30,
+           -30, -10,  30,  40,  40,  30, -10, -30,
+           -30, -10,  30,  40,  40,  30, -10, -30,
+           -30, -10,  20,  30,  30,  20, -10, -30,
+           -30, -30,   0,   0,   0,   0, -30, -30,
+           -50, -30, -30, -30, -30, -30, -30, -50
+        };
+
+        const int* const SQUARES[6][2] = {
+            { PAWN, PAWN_ENDGAME },
+            { KNIGHT, KNIGHT },
+            { BISHOP, BISHOP },
+            { ROOK, ROOK },
+            { QUEEN, QUEEN },
+            { KING, KING_ENDGAME }
+        };
+
+        //Directions 0..3 run towards higher squares, 4..7 towards lower ones
+        const int DIRECTION_FILE[8] = { 0, 1, 1, -1, 0, -1, -1, 1 };
+        const int DIRECTION_RANK[8] = { 1, 1, 0, 1, -1, -1, 0, -1 };
+
+        struct Tables {
+            Bitboard knight[64];
+            Bitboard king[64];
+            Bitboard pawn[2][64];
+            Bitboard rays[8][64];
+            int castleMask[64];
+            std::uint64_t zobrist[12][64];
+            std::uint64_t zobristCastling[16];
+            std::uint64_t zobristPassant[8];
+            std::uint64_t zobristSide;
+            int pieceSquare[12][64][2];
+            int phase[12];
+
+            Bitboard steps(Square s, const int* files, const int* ranks, int n) {
+                Bitboard b = 0;
+
+                for (int i = 0; i < n; i++)
+                    if (isSquare(fileOf(s) + files[i], rankOf(s) + ranks[i]))
+                        b |= bit(makeSquare(fileOf(s) + files[i], rankOf(s) + ranks[i]));
+
+                return b;
+            }
+
+            Tables() {
+                const int knightFiles[8] = { 1, 2, 2, 1, -1, -2, -2, -1 };
+                const int knightRanks[8] = { 2, 1, -1, -2, -2, -1, 1, 2 };
+                const int whitePawnFiles[2] = { -1, 1 };
+                const int whitePawnRanks[2] = { 1, 1 };
+                const int blackPawnRanks[2] = { -1, -1 };
+
+                for (Square s = 0; s < 64; s++) {
+                    knight[s] = steps(s, knightFiles, knightRanks, 8);
+                    king[s] = steps(s, DIRECTION_FILE, DIRECTION_RANK, 8);
+                    pawn[White][s] = steps(s, whitePawnFiles, whitePawnRanks, 2);
+                    pawn[Black][s] = steps(s, whitePawnFiles, blackPawnRanks, 2);
+
+                    for (int d = 0; d < 8; d++) {
+                        rays[d][s] = 0;
+
+                        for (int f = fileOf(s) + DIRECTION_FILE[d], r = rankOf(s) + DIRECTION_RANK[d]; isSquare(f, r); f += DIRECTION_FILE[d], r += DIRECTION_RANK[d])
+                            rays[d][s] |= bit(makeSquare(f, r));
+                    }
+
+                    castleMask[s] = WhiteShort | WhiteLong | BlackShort | BlackLong;
+                }
+
+                //Zobrist keys come from a fixed xorshift sequence so hashes are the same on every run
+                std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+                auto random = [&seed]() {
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+                    return seed;
+                };
+
+                for (int p = 0; p < 12; p++)
+                    for (Square s = 0; s < 64; s++)
+                        zobrist[p][s] = random();
+
+                for (int c = 0; c < 16; c++)
+                    zobristCastling[c] = random();
+
+                for (int f = 0; f < 8; f++)
+                    zobristPassant[f] = random();
+
+                zobristSide = random();
+
+                //Scores are from white's side, so a black piece counts negatively on the mirrored square
+                for (int p = 0; p < 12; p++) {
+                    PieceType t = typeOf(p);
+                    phase[p] = PHASE[t];
+
+                    for (Square s = 0; s < 64; s++) {
+                        Square view = colorOf(p) == White ? s ^ 56 : s;
+                        int sign = colorOf(p) == White ? 1 : -1;
+                        pieceSquare[p][s][Middlegame] = sign * (MIDDLEGAME[t] + SQUARES[t][0][view]);
+                        pieceSquare[p][s][Endgame] = sign * (ENDGAME[t] + SQUARES[t][1][view]);
+                    }
+                }
+
+                castleMask[E1] &= ~(WhiteShort | WhiteLong);
+                castleMask[H1] &= ~WhiteShort;
+                castleMask[A1] &= ~WhiteLong;
+                castleMask[E8] &= ~(BlackShort | BlackLong);
+                castleMask[H8] &= ~BlackShort;
+                castleMask[A8] &= ~BlackLong;
+            }
+        };
+
+        const Tables tables;
+
+        //Classical ray attacks: walk the ray to its first blocker and cut off everything behind it
+        inline Bitboard ray(int d, Square s, Bitboard occupied) {
+            Bitboard attacks = tables.rays[d][s];
+            Bitboard blockers = attacks & occupied;
+
+            if (blockers)
+                attacks ^= tables.rays[d][d < 4 ? lsb(blockers) : msb(blockers)];
+
+            return attacks;
+        }
+    }
+
+    Bitboard knightAttacks(Square s) {
+        return tables.knight[s];
+    }
+
+    Bitboard kingAttacks(Square s) {
+        return tables.king[s];
+    }
+
+    Bitboard pawnAttacks(Color c, Square s) {
+        return tables.pawn[c][s];
+    }
+
+    Bitboard bishopAttacks(Square s, Bitboard occupied) {
+        return ray(1, s, occupied) | ray(3, s, occupied) | ray(5, s, occupied) | ray(7, s, occupied);
+    }
+
+    Bitboard rookAttacks(Square s, Bitboard occupied) {
+        return ray(0, s, occupied) | ray(2, s, occupied) | ray(4, s, occupied) | ray(6, s, occupied);
+    }
+
+    std::string squareName(Square s) {
+        std::string name;
+        name += (char)('a' + fileOf(s));
+        name += (char)('1' + rankOf(s));
+        return name;
+    }
+
+    std::string uci(Move m) {
+        if (m == NO_MOVE)
+            return "0000";
+
+        std::string text = squareName(fromOf(m)) + squareName(toOf(m));
+
+        if (flagOf(m) == Promotion)
+            text += "nbrq"[promotionOf(m) - Knight];
+
+        return text;
+    }
+
+    int pieceSquare(Piece p, Square s, int stage) {
+        return tables.pieceSquare[p][s][stage];
+    }
+
+    int piecePhase(Piece p) {
+        return tables.phase[p];
+    }
+
+    Position::Position() {
+        fromFen(STARTFEN);
+    }
+
+    //The board helpers keep the key and the square scores in step and log what changed since make started
+    void Position::log(Piece p, Square from, Square to) {
+        if (changeCount < MAXCHANGES)
+            changes[changeCount++] = PieceChange{ p, from, to };
+    }
+
+    void Position::put(Piece p, Square s) {
+        byPiece[p] |= bit(s);
+        byColor[colorOf(p)] |= bit(s);
+        occupied |= bit(s);
+        board[s] = p;
+        hash ^= tables.zobrist[p][s];
+        score[Middlegame] += tables.pieceSquare[p][s][Middlegame];
+        score[Endgame] += tables.pieceSquare[p][s][Endgame];
+        material += tables.phase[p];
+        log(p, NO_SQUARE, s);
+    }
+
+    void Position::remove(Square s) {
+        Piece p = board[s];
+        byPiece[p] ^= bit(s);
+        byColor[colorOf(p)] ^= bit(s);
+        occupied ^= bit(s);
+        board[s] = NO_PIECE;
+        hash ^= tables.zobrist[p][s];
+        score[Middlegame] -= tables.pieceSquare[p][s][Middlegame];
+        score[Endgame] -= tables.pieceSquare[p][s][Endgame];
+        material -= tables.phase[p];
+        log(p, s, NO_SQUARE);
+    }
+
+    void Position::move(Square from, Square to) {
+        Piece p = board[from];
+        Bitboard both = bit(from) | bit(to);
+        byPiece[p] ^= both;
+        byColor[colorOf(p)] ^= both;
+        occupied ^= both;
+        board[from] = NO_PIECE;
+        board[to] = p;
+        hash ^= tables.zobrist[p][from] ^ tables.zobrist[p][to];
+        score[Middlegame] += tables.pieceSquare[p][to][Middlegame] - tables.pieceSquare[p][from][Middlegame];
+        score[Endgame] += tables.pieceSquare[p][to][Endgame] - tables.pieceSquare[p][from][Endgame];
+        log(p, from, to);
+    }
+
+    //Accepts the four fields a puzzle needs, the move counters are optional as in EPD
+    bool Position::fromFen(const std::string& fen) {
+        memset(byPiece, 0, sizeof(byPiece));
+        memset(byColor, 0, sizeof(byColor));
+        occupied = 0;
+        hash = 0;
+        score[Middlegame] = 0;
+        score[Endgame] = 0;
+        material = 0;
+        changeCount = 0;
+
+        for (Square s = 0; s < 64; s++)
+            board[s] = NO_PIECE;
+
+        std::istringstream in(fen);
+        std::string placement, color, rights, passant;
+
+        if (!(in >> placement >> color >> rights >> passant))
+            return false;
+
+        int file = 0, rank = 7;
+
+        for (std::size_t i = 0; i < placement.size(); i++) {
+            char c = placement[i];
+
+            if (c == '/') {
+                file = 0;
+                rank--;
+            }
+            else if (c >= '1' && c <= '8') {
+                file += c - '0';
+            }
+            else {
+                const char* p = strchr(PIECES, c);
+
+                if (p == nullptr || !isSquare(file, rank))
+                    return false;
+
+                put((Piece)(p - PIECES), makeSquare(file, rank));
+                file++;
+            }
+        }
+
+        side = color == "b" ? Black : White;
+        castling = 0;
+
+        for (std::size_t i = 0; i < rights.size(); i++) {
+            switch (rights[i]) {
+            case 'K': castling |= WhiteShort; break;
+            case 'Q': castling |= WhiteLong; break;
+            case 'k': castling |= BlackShort; break;
+            case 'q': castling |= BlackLong; break;
+            default: break;
+            }
+        }
+
+        enPassant = passant.size() == 2 ? makeSquare(passant[0] - 'a', passant[1] - '1') : NO_SQUARE;
+        halfmove = 0;
+        fullmove = 1;
+        in >> halfmove >> fullmove;
+
+        hash ^= tables.zobristCastling[castling];
+
+        if (enPassant != NO_SQUARE)
+            hash ^= tables.zobristPassant[fileOf(enPassant)];
+
+        if (side == Black)
+            hash ^= tables.zobristSide;
+
+        return popcount(byPiece[WhiteKing]) == 1 && popcount(byPiece[BlackKing]) == 1;
+    }
+
+    //Places pieces on an empty board with no castling or en passant rights, for positions built from an index
+    bool Position::setup(const Piece* pieces, const Square* squares, int count, Color toMove) {
+        memset(byPiece, 0, sizeof(byPiece));
+        memset(byColor, 0, sizeof(byColor));
+        occupied = 0;
+        hash = 0;
+        score[Middlegame] = 0;
+        score[Endgame] = 0;
+        material = 0;
+        changeCount = 0;
+
+        for (Square s = 0; s < 64; s++)
+            board[s] = NO_PIECE;
+
+        for (int i = 0; i < count; i++) {
+            if (board[squares[i]] != NO_PIECE)
+                return false;
+
+            put(pieces[i], squares[i]);
+        }
+
+        side = toMove;
+        castling = 0;
+        enPassant = NO_SQUARE;
+        halfmove = 0;
+        fullmove = 1;
+        hash ^= tables.zobristCastling[0];
+
+        if (side == Black)
+            hash ^= tables.zobristSide;
+
+        return popcount(byPiece[WhiteKing]) == 1 && popcount(byPiece[BlackKing]) == 1;
+    }
+
+    std::string Position::fen() const {
+        std::string text;
+
+        for (int rank = 7; rank >= 0; rank--) {
+            int empty = 0;
+
+            for (int file = 0; file < 8; file++) {
+                Piece p = board[makeSquare(file, rank)];
+
+                if (p == NO_PIECE) {
+                    empty++;
+                    continue;
+                }
+
+                if (empty > 0)
+                    text += (char)('0' + empty);
+
+                empty = 0;
+                text += PIECES[p];
+            }
+
+            if (empty > 0)
+                text += (char)('0' + empty);
+
+            if (rank > 0)
+                text += '/';
+        }
+
+        text += side == White ? " w " : " b ";
+
+        if (castling == 0)
+            text += '-';
+
+        if (castling & WhiteShort) text += 'K';
+        if (castling & WhiteLong) text += 'Q';
+        if (castling & BlackShort) text += 'k';
+        if (castling & BlackLong) text += 'q';
+
+        text += ' ';
+        text += enPassant == NO_SQUARE ? "-" : squareName(enPassant);
+        text += ' ' + std::to_string(halfmove) + ' ' + std::to_string(fullmove);
+        return text;
+    }
+
+    //Pieces of both colors that reach the square through the given occupancy, used for exchanges with pieces lifted off
+    Bitboard Position::attackers(Square s, Bitboard occupancy) const {
+        return (tables.pawn[Black][s] & byPiece[WhitePawn]) |
+            (tables.pawn[White][s] & byPiece[BlackPawn]) |
+            (tables.knight[s] & (byPiece[WhiteKnight] | byPiece[BlackKnight])) |
+            (tables.king[s] & (byPiece[WhiteKing] | byPiece[BlackKing])) |
+            (bishopAttacks(s, occupancy) & (byPiece[WhiteBishop] | byPiece[BlackBishop] | byPiece[WhiteQueen] | byPiece[BlackQueen])) |
+            (rookAttacks(s, occupancy) & (byPiece[WhiteRook] | byPiece[BlackRook] | byPiece[WhiteQueen] | byPiece[BlackQueen]));
+    }
+
+    bool Position::attacked(Square s, Color by) const {
+        return (tables.pawn[by ^ 1][s] & byPiece[makePiece(by, Pawn)]) ||
+            (tables.knight[s] & byPiece[makePiece(by, Knight)]) ||
+            (tables.king[s] & byPiece[makePiece(by, King)]) ||
+            (bishopAttacks(s, occupied) & (byPiece[makePiece(by, Bishop)] | byPiece[makePiece(by, Queen)])) ||
+            (rookAttacks(s, occupied) & (byPiece[makePiece(by, Rook)] | byPiece[makePiece(by, Queen)]));
+    }
+
+    bool Position::inCheck() const {
+        return attacked(king(side), (Color)(side ^ 1));
+    }
+
+    //Tactical generation keeps captures and promotions only, the moves quiescence search looks at
+    void Position::pseudoLegal(MoveList& list, bool tactical) const {
+        Color them = (Color)(side ^ 1);
+        Bitboard own = byColor[side];
+        Bitboard enemy = byColor[them];
+        int forward = side == White ? 8 : -8;
+        int promotionRank = side == White ? 7 : 0;
+        int startRank = side == White ? 1 : 6;
+
+        Bitboard pawns = byPiece[makePiece(side, Pawn)];
+
+        while (pawns) {
+            Square from = popLsb(pawns);
+            Square to = from + forward;
+            Bitboard targets = tables.pawn[side][from] & enemy;
+
+            if (!(occupied & bit(to)) && (!tactical || rankOf(to) == promotionRank)) {
+                targets |= bit(to);
+
+                if (!tactical && rankOf(from) == startRank && !(occupied & bit(to + forward)))
+                    list.push(makeMove(from, to + forward));
+            }
+
+            while (targets) {
+                to = popLsb(targets);
+
+                if (rankOf(to) == promotionRank) {
+                    for (int t = Queen; t >= Knight; t--)
+                        list.push(makeMove(from, to, Promotion, (PieceType)t));
+                }
+                else {
+                    list.push(makeMove(from, to));
+                }
+            }
+
+            if (enPassant != NO_SQUARE && (tables.pawn[side][from] & bit(enPassant)))
+                list.push(makeMove(from, enPassant, EnPassant));
+        }
+
+        for (int t = Knight; t <= King; t++) {
+            Bitboard movers = byPiece[makePiece(side, (PieceType)t)];
+
+            while (movers) {
+                Square from = popLsb(movers);
+                Bitboard targets;
+
+                switch (t) {
+                case Knight: targets = tables.knight[from]; break;
+                case Bishop: targets = bishopAttacks(from, occupied); break;
+                case Rook: targets = rookAttacks(from, occupied); break;
+                case Queen: targets = bishopAttacks(from, occupied) | rookAttacks(from, occupied); break;
+                default: targets = tables.king[from]; break;
+                }
+
+                targets &= tactical ? enemy : ~own;
+
+                while (targets)
+                    list.push(makeMove(from, popLsb(targets)));
+            }
+        }
+
+        if (tactical)
+            return;
+
+        //Castling only checks the squares here, the king's destination is left to the legality test
+        Square home = side == White ? E1 : E8;
+        int shortRight = side == White ? WhiteShort : BlackShort;
+        int longRight = side == White ? WhiteLong : BlackLong;
+
+        if ((castling & (shortRight | longRight)) && !attacked(home, them)) {
+            if ((castling & shortRight) && !(occupied & (bit(home + 1) | bit(home + 2))) && !attacked(home + 1, them))
+                list.push(makeMove(home, home + 2, Castle));
+
+            if ((castling & longRight) && !(occupied & (bit(home - 1) | bit(home - 2) | bit(home - 3))) && !attacked(home - 1, them))
+                list.push(makeMove(home, home - 2, Castle));
+        }
+    }
+
+    bool Position::legal(Move m) {
+        Undo undo;
+        Color us = side;
+        make(m, undo);
+        bool ok = !attacked(king(us), side);
+        unmake(m, undo);
+        return ok;
+    }
+
+    void Position::generate(MoveList& list) {
+        MoveList all;
+        pseudoLegal(all, false);
+        list.size = 0;
+
+        for (int i = 0; i < all.size; i++)
+            if (legal(all.moves[i]))
+                list.push(all.moves[i]);
+    }
+
+    void Position::captures(MoveList& list) {
+        MoveList all;
+        pseudoLegal(all, true);
+        list.size = 0;
+
+        for (int i = 0; i < all.size; i++)
+            if (legal(all.moves[i]))
+                list.push(all.moves[i]);
+    }
+
+    bool Position::checkmate() {
+        MoveList list;
+        generate(list);
+        return list.size == 0 && inCheck();
+    }
+
+    bool Position::stalemate() {
+        MoveList list;
+        generate(list);
+        return list.size == 0 && !inCheck();
+    }
+
+    void Position::make(Move m, Undo& undo) {
+        Square from = fromOf(m);
+        Square to = toOf(m);
+        int flag = flagOf(m);
+
+        undo.captured = board[to];
+        undo.castling = castling;
+        undo.enPassant = enPassant;
+        undo.halfmove = halfmove;
+        undo.key = hash;
+
+        changeCount = 0;
+        halfmove++;
+
+        if (flag == EnPassant) {
+            Square victim = to - (side == White ? 8 : -8);
+            undo.captured = board[victim];
+            remove(victim);
+        }
+        else if (undo.captured != NO_PIECE) {
+            remove(to);
+            halfmove = 0;
+        }
+
+        if (typeOf(board[from]) == Pawn)
+            halfmove = 0;
+
+        move(from, to);
+
+        if (flag == Promotion) {
+            remove(to);
+            put(makePiece(side, promotionOf(m)), to);
+        }
+        else if (flag == Castle) {
+            if (to > from)
+                move(to + 1, to - 1);
+            else
+                move(to - 2, to + 1);
+        }
+
+        if (enPassant != NO_SQUARE)
+            hash ^= tables.zobristPassant[fileOf(enPassant)];
+
+        enPassant = NO_SQUARE;
+
+        if (typeOf(board[to]) == Pawn && (to - from == 16 || from - to == 16)) {
+            enPassant = (from + to) / 2;
+            hash ^= tables.zobristPassant[fileOf(enPassant)];
+        }
+
+        hash ^= tables.zobristCastling[castling];
+        castling &= tables.castleMask[from] & tables.castleMask[to];
+        hash ^= tables.zobristCastling[castling] ^ tables.zobristSide;
+
+        if (side == Black)
+            fullmove++;
+
+        side = (Color)(side ^ 1);
+    }
+
+    void Position::unmake(Move m, const Undo& undo) {
+        Square from = fromOf(m);
+        Square to = toOf(m);
+        int flag = flagOf(m);
+
+        side = (Color)(side ^ 1);
+
+        if (side == Black)
+            fullmove--;
+
+        if (flag == Promotion) {
+            remove(to);
+            put(makePiece(side, Pawn), to);
+        }
+        else if (flag == Castle) {
+            if (to > from)
+                move(to - 1, to + 1);
+            else
+                move(to + 1, to - 2);
+        }
+
+        move(to, from);
+
+        if (flag == EnPassant)
+            put(undo.captured, to - (side == White ? 8 : -8));
+        else if (undo.captured != NO_PIECE)
+            put(undo.captured, to);
+
+        castling = undo.castling;
+        enPassant = undo.enPassant;
+        halfmove = undo.halfmove;
+        hash = undo.key;
+    }
+
+    Move Position::parseUci(const std::string& text) {
+        MoveList list;
+        generate(list);
+
+        for (int i = 0; i < list.size; i++)
+            if (uci(list.moves[i]) == text)
+                return list.moves[i];
+
+        return NO_MOVE;
+    }
+
+    std::string Position::san(Move m) {
+        Square from = fromOf(m);
+        Square to = toOf(m);
+        PieceType type = typeOf(board[from]);
+        bool capture = board[to] != NO_PIECE || flagOf(m) == EnPassant;
+        std::string text;
+
+        if (flagOf(m) == Castle) {
+            text = to > from ? "O-O" : "O-O-O";
+        }
+        else if (type == Pawn) {
+            if (capture) {
+                text += (char)('a' + fileOf(from));
+                text += 'x';
+            }
+
+            text += squareName(to);
+
+            if (flagOf(m) == Promotion) {
+                text += '=';
+                text += "NBRQ"[promotionOf(m) - Knight];
+            }
+        }
+        else {
+            text += "PNBRQK"[type];
+
+            //Disambiguate by file, then rank, then both, against the other legal moves of the same piece to the same square
+            MoveList list;
+            generate(list);
+            bool ambiguous = false, sameFile = false, sameRank = false;
+
+            for (int i = 0; i < list.size; i++) {
+                Square other = fromOf(list.moves[i]);
+
+                if (other == from || toOf(list.moves[i]) != to || board[other] != board[from])
+                    continue;
+
+                ambiguous = true;
+                sameFile |= fileOf(other) == fileOf(from);
+                sameRank |= rankOf(other) == rankOf(from);
+            }
+
+            if (ambiguous) {
+                if (!sameFile)
+                    text += (char)('a' + fileOf(from));
+                else if (!sameRank)
+                    text += (char)('1' + rankOf(from));
+                else
+                    text += squareName(from);
+            }
+
+            if (capture)
+                text += 'x';
+
+            text += squareName(to);
+        }
+
+        Undo undo;
+        make(m, undo);
+
+        if (inCheck())
+            text += checkmate() ? '#' : '+';
+
+        unmake(m, undo);
+        return text;
+    }
+
+    //Compares against the SAN of every legal move, ignoring check marks and annotations
+    Move Position::parseSan(const std::string& text) {
+        std::string wanted = text;
+
+        while (!wanted.empty() && strchr("+#!?", wanted.back()))
+            wanted.pop_back();
+
+        for (std::size_t i = 0; i < wanted.size(); i++)
+            if (wanted[i] == '0')
+                wanted[i] = 'O';
+
+        MoveList list;
+        generate(list);
+
+        for (int i = 0; i < list.size; i++) {
+            std::string candidate = san(list.moves[i]);
+
+            while (!candidate.empty() && strchr("+#", candidate.back()))
+                candidate.pop_back();
+
+            if (candidate == wanted)
+                return list.moves[i];
+        }
+
+        return NO_MOVE;
+    }
+}
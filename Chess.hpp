@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Squares are numbered 0..63 from a1 to h8, rank by rank, shared by the board view and the chess model
+namespace Chess {
+    typedef int Square;
+
+    enum : Square {
+        A1, B1, C1, D1, E1, F1, G1, H1,
+        A2, B2, C2, D2, E2, F2, G2, H2,
+        A3, B3, C3, D3, E3, F3, G3, H3,
+        A4, B4, C4, D4, E4, F4, G4, H4,
+        A5, B5, C5, D5, E5, F5, G5, H5,
+        A6, B6, C6, D6, E6, F6, G6, H6,
+        A7, B7, C7, D7, E7, F7, G7, H7,
+        A8, B8, C8, D8, E8, F8, G8, H8,
+        NO_SQUARE = -1
+    };
+
+    inline Square makeSquare(int file, int rank) {
+        return rank * 8 + file;
+    }
+
+    inline int fileOf(Square s) {
+        return s & 7;
+    }
+
+    inline int rankOf(Square s) {
+        return s >> 3;
+    }
+
+    inline bool isSquare(int file, int rank) {
+        return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+    }
+
+    typedef std::uint64_t Bitboard;
+
+    inline Bitboard bit(Square s) {
+        return (Bitboard)1 << s;
+    }
+
+    inline int popcount(Bitboard b) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(b);
+#else
+        b = b - ((b >> 1) & 0x5555555555555555ull);
+        b = (b & 0x3333333333333333ull) + ((b >> 2) & 0x3333333333333333ull);
+        b = (b + (b >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return (int)((b * 0x0101010101010101ull) >> 56);
+#endif
+    }
+
+    //Both scans expect a non-empty board
+    inline Square lsb(Bitboard b) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(b);
+#elif defined(_WIN64)
+        unsigned long i;
+        _BitScanForward64(&i, b);
+        return (Square)i;
+#else
+        unsigned long i;
+
+        if (_BitScanForward(&i, (unsigned long)b))
+            return (Square)i;
+
+        _BitScanForward(&i, (unsigned long)(b >> 32));
+        return (Square)i + 32;
+#endif
+    }
+
+    inline Square msb(Bitboard b) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(b);
+#elif defined(_WIN64)
+        unsigned long i;
+        _BitScanReverse64(&i, b);
+        return (Square)i;
+#else
+        unsigned long i;
+
+        if (_BitScanReverse(&i, (unsigned long)(b >> 32)))
+            return (Square)i + 32;
+
+        _BitScanReverse(&i, (unsigned long)b);
+        return (Square)i;
+#endif
+    }
+
+    inline Square popLsb(Bitboard& b) {
+        Square s = lsb(b);
+        b &= b - 1;
+        return s;
+    }
+
+    enum Color {
+        White,
+        Black
+    };
+
+    enum PieceType {
+        Pawn,
+        Knight,
+        Bishop,
+        Rook,
+        Queen,
+        King
+    };
+
+    //Piece codes follow the board view's PIECE order, white pieces first
+    typedef int Piece;
+
+    enum : Piece {
+        WhitePawn, WhiteKnight, WhiteBishop, WhiteRook, WhiteQueen, WhiteKing,
+        BlackPawn, BlackKnight, BlackBishop, BlackRook, BlackQueen, BlackKing,
+        NO_PIECE = -1
+    };
+
+    inline Piece makePiece(Color c, PieceType t) {
+        return c * 6 + t;
+    }
+
+    inline PieceType typeOf(Piece p) {
+        return (PieceType)(p % 6);
+    }
+
+    inline Color colorOf(Piece p) {
+        return (Color)(p / 6);
+    }
+
+    enum CASTLING {
+        WhiteShort = 1,
+        WhiteLong = 2,
+        BlackShort = 4,
+        BlackLong = 8
+    };
+
+    //From and to in the low 12 bits, then the promotion piece and a flag for the moves that touch a third square
+    typedef std::uint16_t Move;
+
+    enum MOVEFLAG {
+        Normal = 0,
+        Promotion = 1 << 14,
+        EnPassant = 2 << 14,
+        Castle = 3 << 14
+    };
+
+    const Move NO_MOVE = 0;
+
+    inline Move makeMove(Square from, Square to, int flag = Normal, PieceType promotion = Knight) {
+        return (Move)(from | (to << 6) | ((promotion - Knight) << 12) | flag);
+    }
+
+    inline Square fromOf(Move m) {
+        return m & 63;
+    }
+
+    inline Square toOf(Move m) {
+        return (m >> 6) & 63;
+    }
+
+    inline int flagOf(Move m) {
+        return m & (3 << 14);
+    }
+
+    inline PieceType promotionOf(Move m) {
+        return (PieceType)(((m >> 12) & 3) + Knight);
+    }
+
+    struct MoveList {
+        Move moves[256];
+        int size;
+
+        MoveList() :
+            size(0)
+        {}
+
+        void push(Move m) {
+            moves[size++] = m;
+        }
+    };
+
+    //Everything make cannot recompute on the way back
+    struct Undo {
+        Piece captured;
+        int castling;
+        Square enPassant;
+        int halfmove;
+        std::uint64_t key;
+    };
+
+    enum Stage {
+        Middlegame,
+        Endgame
+    };
+
+    //All pieces but pawns and kings on the board make the full middlegame phase
+    const int PHASEMAX = 24;
+    const int MAXCHANGES = 6;
+
+    //A piece that was added (from is NO_SQUARE), removed (to is NO_SQUARE) or moved
+    struct PieceChange {
+        Piece piece;
+        Square from;
+        Square to;
+    };
+
+    int pieceSquare(Piece p, Square s, int stage);
+    int piecePhase(Piece p);
+
+    Bitboard knightAttacks(Square s);
+    Bitboard kingAttacks(Square s);
+    Bitboard pawnAttacks(Color c, Square s);
+    Bitboard bishopAttacks(Square s, Bitboard occupied);
+    Bitboard rookAttacks(Square s, Bitboard occupied);
+
+    std::string squareName(Square s);
+    std::string uci(Move m);
+
+    extern const char* STARTFEN;
+
+    class Position {
+        Bitboard byPiece[12];
+        Bitboard byColor[2];
+        Bitboard occupied;
+        Piece board[64];
+        Color side;
+        int castling;
+        Square enPassant;
+        int halfmove;
+        int fullmove;
+        std::uint64_t hash;
+        int score[2];
+        int material;
+        PieceChange changes[MAXCHANGES];
+        int changeCount;
+
+        void log(Piece p, Square from, Square to);
+        void put(Piece p, Square s);
+        void remove(Square s);
+        void move(Square from, Square to);
+        void pseudoLegal(MoveList& list, bool tactical) const;
+
+    public:
+        Position();
+
+        bool fromFen(const std::string& fen);
+        bool setup(const Piece* pieces, const Square* squares, int count, Color toMove);
+        std::string fen() const;
+
+        Piece pieceOn(Square s) const { return board[s]; }
+        Bitboard pieces(Piece p) const { return byPiece[p]; }
+        Bitboard pieces(Color c) const { return byColor[c]; }
+        Bitboard pieces() const { return occupied; }
+        Color sideToMove() const { return side; }
+        int castlingRights() const { return castling; }
+        Square enPassantSquare() const { return enPassant; }
+        int halfmoveClock() const { return halfmove; }
+        Square king(Color c) const { return lsb(byPiece[makePiece(c, King)]); }
+        std::uint64_t key() const { return hash; }
+
+        //Material and square scores from white's side, kept up to date by every change to the board
+        int middlegame() const { return score[Middlegame]; }
+        int endgame() const { return score[Endgame]; }
+        int phase() const { return material < PHASEMAX ? material : PHASEMAX; }
+
+        //The pieces the last make added, removed or moved, in the order it touched them
+        const PieceChange* changed(int& count) const { count = changeCount; return changes; }
+
+        Bitboard attackers(Square s, Bitboard occupancy) const;
+        bool attacked(Square s, Color by) const;
+        bool inCheck() const;
+        bool legal(Move m);
+        void generate(MoveList& list);
+        void captures(MoveList& list);
+        bool checkmate();
+        bool stalemate();
+
+        void make(Move m, Undo& undo);
+        void unmake(Move m, const Undo& undo);
+
+        Move parseUci(const std::string& text);
+        Move parseSan(const std::string& text);
+        std::string san(Move m);
+    };
+}
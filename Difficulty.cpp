@@ -0,0 +1,354 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Puzzle.hpp"
+#include "Search.hpp"
+#include "Tablebase.hpp"
+#include "FileSystem.hpp"
+
+#define DIFFICULTYDEPTH 16
+#define DIFFICULTYNODES 400000
+#define PLAUSIBLE 60
+#define INFLIGHT 4096
+#define PROGRESS 1000
+
+using namespace Chess;
+
+struct Options {
+    int threads;
+    std::uint64_t nodes;
+    std::size_t hash;
+    std::string input;
+    std::string output;
+};
+
+//What makes a puzzle hard: how deep the search has to look before it settles on an answer the puzzle accepts, how
+//many other moves look about as good at one ply, and how much material the answer wins
+struct Metrics {
+    int depth;
+    bool found;
+    int alternatives;
+    int swing;
+    bool quiet;
+};
+
+//One Elo-like number on the scale the game rates puzzles on, so a graded pack seeds the ratings without any plays
+int difficulty(const Metrics& m) {
+    int rating = 800 + 120 * (m.depth - 1) + 80 * std::min(m.alternatives, 8) + (m.quiet ? 150 : 0) - std::min(m.swing, 900) / 9;
+
+    if (!m.found)
+        rating += 300;
+
+    return std::max(400, std::min(2800, rating));
+}
+
+//Captures, promotions and checks are where a solver looks first
+bool quiet(const Position& position, Move m) {
+    if (position.pieceOn(toOf(m)) != NO_PIECE || flagOf(m) == EnPassant || flagOf(m) == Promotion)
+        return false;
+
+    Position after = position;
+    Undo undo;
+    after.make(m, undo);
+    return !after.inCheck();
+}
+
+//The worker's table is allocated once and cleared for each puzzle, so a grade does not depend on which puzzles the
+//same worker saw before it
+Metrics analyse(const Puzzle& puzzle, Search& search, TranspositionTable& table, std::uint64_t nodes) {
+    Metrics m = { 0, false, 0, 0, false };
+    MoveList legal;
+    Position position = puzzle.position;
+    position.generate(legal);
+
+    //Every root move scored at one ply plus quiescence, the way a quick look sees them
+    SearchLimits glance;
+    glance.depth = 1;
+    glance.lines = legal.size;
+    SearchResult first = search.run(puzzle.position, glance);
+    int answer = -INFINITY_SCORE;
+
+    for (const SearchLine& line : first.lines)
+        if (puzzle.accepts(line.move))
+            answer = std::max(answer, line.score);
+
+    for (const SearchLine& line : first.lines)
+        if (!puzzle.accepts(line.move) && line.score >= answer - PLAUSIBLE)
+            m.alternatives++;
+
+    table.clear();
+    SearchLimits deep;
+    deep.depth = DIFFICULTYDEPTH;
+    deep.nodes = nodes;
+    deep.table = &table;
+    deep.iteration = [&](const SearchResult& r) {
+        bool accepted = puzzle.accepts(r.best);
+
+        if (accepted && !m.found)
+            m.depth = r.depth;
+
+        m.found = accepted;
+
+        if (!accepted)
+            m.depth = r.depth + 1;
+    };
+
+    SearchResult result = search.run(puzzle.position, deep);
+    m.depth = std::max(m.depth, 1);
+    m.swing = isMateDistance(result.score) ? 900 : std::max(0, result.score - evaluate(puzzle.position));
+    Move solution = m.found ? result.best : puzzle.expected(0);
+    m.quiet = solution != NO_MOVE && quiet(puzzle.position, solution);
+    return m;
+}
+
+//Lines go to the workers in file order with a sequence number and come back out of order, the writer puts them back
+//in order. At most INFLIGHT lines are held at once, so a pack of any size streams through in constant memory
+class Batch {
+    struct Job {
+        std::uint64_t sequence;
+        std::string line;
+    };
+
+    std::deque<Job> jobs;
+    std::map<std::uint64_t, std::string> done;
+    std::uint64_t total;
+    bool finished;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+public:
+    Batch() : total(0), finished(false) {}
+
+    void push(const std::string& line) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return jobs.size() + done.size() < INFLIGHT; });
+        jobs.push_back(Job{ total++, line });
+        wake.notify_all();
+    }
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        wake.notify_all();
+    }
+
+    bool pop(std::uint64_t& sequence, std::string& line) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return finished || !jobs.empty(); });
+
+        if (jobs.empty())
+            return false;
+
+        sequence = jobs.front().sequence;
+        line = jobs.front().line;
+        jobs.pop_front();
+        return true;
+    }
+
+    void complete(std::uint64_t sequence, const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done[sequence] = line;
+        wake.notify_all();
+    }
+
+    //Waits for the line with the given sequence number, false once the input has ended before it
+    bool take(std::uint64_t sequence, std::string& line) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return done.count(sequence) != 0 || (finished && sequence >= total); });
+
+        if (done.count(sequence) == 0)
+            return false;
+
+        line = done[sequence];
+        done.erase(sequence);
+        wake.notify_all();
+        return true;
+    }
+};
+
+//Counts the whole lines a run that was cut short left behind. A line torn by the interruption is cut off, the rest
+//would be appended behind it
+std::uint64_t resume(const std::string& partial) {
+    std::ifstream previous(partial, std::ios::binary);
+    std::string kept;
+    std::string line;
+    std::uint64_t lines = 0;
+
+    if (!previous)
+        return 0;
+
+    while (std::getline(previous, line)) {
+        if (previous.eof())
+            break;
+
+        kept += line + '\n';
+        lines++;
+    }
+
+    if (!line.empty() && previous.eof()) {
+        previous.close();
+        std::ofstream rewrite(partial, std::ios::binary | std::ios::trunc);
+        rewrite << kept;
+    }
+
+    return lines;
+}
+
+void usage() {
+    printf("Difficulty [--threads n] [--nodes n] [--hash mb] [--out path] pack.epd\n");
+    printf("Writes a difficulty opcode into every puzzle of the pack, in place unless --out is given.\n");
+    printf("An interrupted run picks up where it stopped from the partial output.\n");
+}
+
+//The input is read on this thread while the workers grade, one search and one table each. Comments and lines that do
+//not parse are copied through unchanged
+int main(int argc, char** argv) {
+    Options options = { (int)std::max(1u, std::thread::hardware_concurrency()), DIFFICULTYNODES, HASHMB, "", "" };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.threads = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            options.nodes = std::max(1000ull, strtoull(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+            options.hash = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            options.output = argv[++i];
+        else
+            options.input = argv[i];
+    }
+
+    if (options.input.empty()) {
+        usage();
+        return 1;
+    }
+
+    Tablebases::instance().load(TBPATH);
+    Network::instance().load(NNUEPATH);
+
+    std::string partial = (options.output.empty() ? options.input : options.output) + ".partial";
+    std::ifstream in(options.input);
+
+    if (!in) {
+        printf("could not read %s\n", options.input.c_str());
+        return 1;
+    }
+
+    //Lines already in the partial output are skipped and not graded again
+    std::uint64_t skipped = resume(partial);
+    std::string line;
+    FILE* out = fopen(partial.c_str(), "a");
+
+    if (out == nullptr) {
+        printf("could not write %s\n", partial.c_str());
+        return 1;
+    }
+
+    for (std::uint64_t i = 0; i < skipped && std::getline(in, line); i++) {}
+
+    if (skipped > 0)
+        printf("resuming after %llu lines\n", (unsigned long long)skipped);
+
+    Batch batch;
+    std::mutex statsMutex;
+    std::uint64_t graded = 0;
+    std::uint64_t unsolved = 0;
+    std::uint64_t histogram[6] = {};
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int t = 0; t < options.threads; t++) {
+        workers.push_back(std::thread([&] {
+            Search search;
+            TranspositionTable table(options.hash);
+            std::uint64_t sequence;
+            std::string text;
+
+            while (batch.pop(sequence, text)) {
+                Puzzle puzzle;
+
+                if (text.empty() || text[0] == '#' || !PuzzlePack::parse(text, puzzle) || puzzle.solution.empty() || puzzle.solution[0].count == 0) {
+                    batch.complete(sequence, text);
+                    continue;
+                }
+
+                Metrics m = analyse(puzzle, search, table, options.nodes);
+                int rating = difficulty(m);
+                puzzle.operations["difficulty"] = std::to_string(rating);
+                batch.complete(sequence, puzzle.epd());
+
+                std::lock_guard<std::mutex> lock(statsMutex);
+                graded++;
+                unsolved += !m.found;
+                histogram[std::min(5, (rating - 400) / 400)]++;
+
+                if (graded % PROGRESS == 0) {
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    printf("%llu graded, %.1f per second\n", (unsigned long long)graded, graded / seconds);
+                    fflush(stdout);
+                }
+            }
+        }));
+    }
+
+    //Finished lines are appended in input order as soon as the ones before them are
+    bool ok = true;
+
+    std::thread writer([&] {
+        std::string text;
+
+        for (std::uint64_t sequence = 0; batch.take(sequence, text); sequence++) {
+            ok = fprintf(out, "%s\n", text.c_str()) >= 0 && ok;
+
+            if (sequence % PROGRESS == 0)
+                fflush(out);
+        }
+    });
+
+    while (std::getline(in, line))
+        batch.push(line);
+
+    batch.finish();
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    writer.join();
+    in.close();
+
+    if (ok)
+        FileSystem::sync(out);
+
+    ok = fclose(out) == 0 && ok;
+
+    //The partial file only replaces the destination once it holds every line, in one step so the pack is never missing
+    std::string destination = options.output.empty() ? options.input : options.output;
+
+    if (!ok || !FileSystem::replace(partial, destination)) {
+        printf("could not write %s, the graded lines are in %s\n", destination.c_str(), partial.c_str());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%llu puzzles graded in %.1f s with %d threads, %llu not solved within %llu nodes\n", (unsigned long long)graded,
+        seconds, options.threads, (unsigned long long)unsolved, (unsigned long long)options.nodes);
+
+    for (int i = 0; i < 6; i++)
+        printf("%4d-%-4d %llu\n", 400 + 400 * i, i < 5 ? 799 + 400 * i : 2800, (unsigned long long)histogram[i]);
+
+    return 0;
+}
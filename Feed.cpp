@@ -0,0 +1,133 @@
+#include "Feed.hpp"
+
+//Moves that are not legal in the puzzle position are wrong without asking the puzzle
+PuzzleStep PreparedPuzzle::step(Chess::Move m) const {
+    for (std::size_t i = 0; i < moves.size(); i++)
+        if (moves[i] == m)
+            return steps[i];
+
+    PuzzleStep wrong = { false, false, Chess::NO_MOVE, 0 };
+    return wrong;
+}
+
+PuzzleFeed::PuzzleFeed(const PuzzlePack& pack) :
+    pack(pack),
+    next(0),
+    stopping(false)
+{
+    worker = std::thread(&PuzzleFeed::fill, this);
+}
+
+PuzzleFeed::~PuzzleFeed() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wake.notify_all();
+    worker.join();
+}
+
+void PuzzleFeed::prepare(const Puzzle& puzzle, PreparedPuzzle& out) {
+    Chess::MoveList list;
+    Chess::Position position = puzzle.position;
+    position.generate(list);
+
+    out.puzzle = &puzzle;
+    out.moves.assign(list.moves, list.moves + list.size);
+    out.steps.clear();
+    out.pieces.clear();
+
+    for (int i = 0; i < list.size; i++)
+        out.steps.push_back(puzzle.step(0, puzzle.position, list.moves[i]));
+
+    for (Chess::Square s = Chess::A1; s <= Chess::H8; s++)
+        if (puzzle.position.pieceOn(s) != Chess::NO_PIECE)
+            out.pieces.push_back(std::make_pair(s, puzzle.position.pieceOn(s)));
+}
+
+//Slots are filled in queue order. The one being prepared is only touched by the worker, a clear meanwhile leaves it
+//for the worker to drop when it comes back
+void PuzzleFeed::fill() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [this] { return stopping || next < queue.size(); });
+
+        if (stopping)
+            return;
+
+        std::size_t index = queue[next].prepared.index;
+        lock.unlock();
+
+        PreparedPuzzle prepared;
+        prepared.index = index;
+        prepare(pack.puzzles[index], prepared);
+
+        lock.lock();
+
+        if (next < queue.size() && queue[next].prepared.index == index && !queue[next].ready) {
+            queue[next].prepared = std::move(prepared);
+            queue[next].ready = true;
+            next++;
+        }
+
+        wake.notify_all();
+    }
+}
+
+void PuzzleFeed::request(std::size_t index) {
+    if (index >= pack.size())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Slot slot;
+        slot.prepared.index = index;
+        slot.prepared.puzzle = nullptr;
+        slot.ready = false;
+        queue.push_back(slot);
+    }
+
+    wake.notify_all();
+}
+
+//Waits for the oldest request when the worker has not got to it yet, which only happens when the feed runs dry
+bool PuzzleFeed::take(PreparedPuzzle& out) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (queue.empty())
+        return false;
+
+    wake.wait(lock, [this] { return stopping || queue.front().ready; });
+
+    if (!queue.front().ready)
+        return false;
+
+    out = std::move(queue.front().prepared);
+    queue.pop_front();
+    next--;
+    return true;
+}
+
+bool PuzzleFeed::queued(std::size_t index) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (const Slot& slot : queue)
+        if (slot.prepared.index == index)
+            return true;
+
+    return false;
+}
+
+std::size_t PuzzleFeed::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+//Prepared puzzles are dropped, a slot the worker is still preparing goes too and its result is thrown away
+void PuzzleFeed::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.clear();
+    next = 0;
+}
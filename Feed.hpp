@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Chess.hpp"
+#include "Puzzle.hpp"
+
+#define PREFETCH 4
+
+//A puzzle made ready to play: every legal first move already judged, so the first answer is a lookup that never
+//touches the tablebases, and the pieces to place listed in the order the board creates them
+struct PreparedPuzzle {
+    std::size_t index;
+    const Puzzle* puzzle;
+    std::vector<Chess::Move> moves;
+    std::vector<PuzzleStep> steps;
+    std::vector<std::pair<Chess::Square, Chess::Piece>> pieces;
+
+    PuzzleStep step(Chess::Move m) const;
+};
+
+//Puzzles queued by pack index are prepared in order on a worker thread, a few levels ahead of the one being played.
+//The pack must outlive the feed and not change while it runs
+class PuzzleFeed {
+    struct Slot {
+        PreparedPuzzle prepared;
+        bool ready;
+    };
+
+    const PuzzlePack& pack;
+    std::deque<Slot> queue;
+    std::size_t next;
+    bool stopping;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+
+    void fill();
+
+public:
+    static void prepare(const Puzzle& puzzle, PreparedPuzzle& out);
+
+    PuzzleFeed(const PuzzlePack& pack);
+    ~PuzzleFeed();
+    PuzzleFeed(const PuzzleFeed&) = delete;
+    void operator=(const PuzzleFeed&) = delete;
+
+    void request(std::size_t index);
+    bool take(PreparedPuzzle& out);
+    bool queued(std::size_t index) const;
+    std::size_t size() const;
+    void clear();
+};
@@ -0,0 +1,41 @@
+#include "FileSystem.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FileSystem {
+    //An existing directory is fine, a missing one shows up when the first file in it fails to open
+    void makeDirectory(const std::string& path) {
+#ifdef _WIN32
+        CreateDirectoryA(path.c_str(), NULL);
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    //fflush only reaches the OS, the data is not safe until the OS has it on disk
+    void sync(FILE* file) {
+        fflush(file);
+#ifdef _WIN32
+        _commit(_fileno(file));
+#else
+        fsync(fileno(file));
+#endif
+    }
+
+    //Readers see either the old file or the new one, never a half written one
+    bool replace(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+//The few platform calls the save files need, so the stores and tools share one copy of the #ifdefs
+namespace FileSystem {
+    void makeDirectory(const std::string& path);
+    void sync(FILE* file);
+    bool replace(const std::string& from, const std::string& to);
+}
@@ -0,0 +1,195 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Hints.hpp"
+#include "Search.hpp"
+#include "FileSystem.hpp"
+#include <cstdio>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+
+HintCache::HintCache(const std::string& directory) :
+    path(directory + "/hints.txt"),
+    stopping(false),
+    cancel(false)
+{
+    FileSystem::makeDirectory(directory);
+    load();
+    worker = std::thread(&HintCache::analyse, this);
+}
+
+HintCache::~HintCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    cancel = true;
+
+    wake.notify_all();
+    worker.join();
+}
+
+//Puzzles without an id are known by their position alone
+std::string HintCache::key(const Puzzle& puzzle) {
+    return puzzle.id.empty() ? placement(puzzle.position) : puzzle.id;
+}
+
+//The FEN without the move counters, which a pack does not always carry
+std::string HintCache::placement(const Chess::Position& position) {
+    std::string fen = position.fen();
+    return fen.substr(0, fen.rfind(' ', fen.rfind(' ') - 1));
+}
+
+//One line per puzzle: id, position, depth, then uci move and score pairs, tab separated. A later line for the same id
+//replaces an earlier one and a torn last line is skipped
+void HintCache::load() {
+    std::ifstream in(path);
+    std::string line;
+
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string id, fen, depth, moves;
+
+        if (!std::getline(fields, id, '\t') || !std::getline(fields, fen, '\t') || !std::getline(fields, depth, '\t') || !std::getline(fields, moves))
+            continue;
+
+        Chess::Position position;
+
+        if (!position.fromFen(fen))
+            continue;
+
+        Hint hint;
+        hint.fen = fen;
+        hint.depth = atoi(depth.c_str());
+
+        std::istringstream pairs(moves);
+        std::string uci;
+        int score;
+
+        while (pairs >> uci >> score) {
+            Chess::Move m = position.parseUci(uci);
+
+            if (m == Chess::NO_MOVE)
+                break;
+
+            hint.moves.push_back(m);
+            hint.scores.push_back(score);
+        }
+
+        if (!hint.moves.empty())
+            hints[id] = hint;
+    }
+}
+
+void HintCache::append(const std::string& id, const Hint& hint) {
+    FILE* file = fopen(path.c_str(), "a");
+
+    if (file == nullptr)
+        return;
+
+    fprintf(file, "%s\t%s\t%d\t", id.c_str(), hint.fen.c_str(), hint.depth);
+
+    for (std::size_t i = 0; i < hint.moves.size(); i++)
+        fprintf(file, "%s%s %d", i > 0 ? " " : "", Chess::uci(hint.moves[i]).c_str(), hint.scores[i]);
+
+    fprintf(file, "\n");
+    fclose(file);
+}
+
+Hint HintCache::search(const Chess::Position& position, const std::atomic<bool>* stop) {
+    Chess::Search search;
+    Chess::SearchLimits limits;
+    limits.depth = HINTDEPTH;
+    limits.nodes = HINTNODES;
+    limits.lines = HINTLINES;
+    limits.stop = stop;
+
+    Chess::SearchResult result = search.run(position, limits);
+    Hint hint;
+    hint.fen = placement(position);
+    hint.depth = result.depth;
+
+    for (const Chess::SearchLine& line : result.lines) {
+        hint.moves.push_back(line.move);
+        hint.scores.push_back(line.score);
+    }
+
+    return hint;
+}
+
+void HintCache::analyse() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+
+        if (stopping)
+            return;
+
+        Job job = queue.front();
+        lock.unlock();
+
+        Hint hint = search(job.position, &cancel);
+
+        //A search cut short by shutting down is not worth keeping
+        if (cancel)
+            return;
+
+        if (!hint.moves.empty())
+            append(job.id, hint);
+
+        lock.lock();
+
+        if (stopping)
+            return;
+
+        queue.pop_front();
+
+        if (!hint.moves.empty())
+            hints[job.id] = hint;
+
+        wake.notify_all();
+    }
+}
+
+//A puzzle already queued or analysed for the same position is not searched again
+void HintCache::request(const Puzzle& puzzle) {
+    std::string id = key(puzzle);
+    std::string fen = placement(puzzle.position);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = hints.find(id);
+
+        if (it != hints.end() && it->second.fen == fen)
+            return;
+
+        for (const Job& job : queue)
+            if (job.id == id)
+                return;
+
+        queue.push_back(Job{ id, puzzle.position });
+    }
+
+    wake.notify_all();
+}
+
+bool HintCache::lookup(const Puzzle& puzzle, Hint& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = hints.find(key(puzzle));
+
+    if (it == hints.end() || it->second.fen != placement(puzzle.position))
+        return false;
+
+    out = it->second;
+    return true;
+}
+
+//Blocks until every requested puzzle has been analysed
+void HintCache::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this] { return queue.empty(); });
+}
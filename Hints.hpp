@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "Chess.hpp"
+#include "Puzzle.hpp"
+
+#define HINTLINES 3
+#define HINTDEPTH 8
+#define HINTNODES 3000000
+
+//The best few moves of one puzzle position, best first, with the depth they were searched to
+struct Hint {
+    std::string fen;
+    int depth;
+    std::vector<Chess::Move> moves;
+    std::vector<int> scores;
+};
+
+//Multi-PV analysis per puzzle id, kept in one text file that only grows. Puzzles requested while their analysis is
+//missing or was made for another position go to a worker thread, so asking for a hint is never more than a lookup
+class HintCache {
+    struct Job {
+        std::string id;
+        Chess::Position position;
+    };
+
+    std::string path;
+    std::map<std::string, Hint> hints;
+    std::deque<Job> queue;
+    bool stopping;
+    std::atomic<bool> cancel;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+
+    static std::string key(const Puzzle& puzzle);
+    static std::string placement(const Chess::Position& position);
+
+    void load();
+    void append(const std::string& id, const Hint& hint);
+    void analyse();
+
+public:
+    static Hint search(const Chess::Position& position, const std::atomic<bool>* stop = nullptr);
+
+    HintCache(const std::string& directory);
+    ~HintCache();
+    HintCache(const HintCache&) = delete;
+    void operator=(const HintCache&) = delete;
+
+    void request(const Puzzle& puzzle);
+    bool lookup(const Puzzle& puzzle, Hint& out) const;
+    void wait();
+};
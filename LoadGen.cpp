@@ -0,0 +1,263 @@
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <SFML/Network.hpp>
+#include "Protocol.hpp"
+#include "Puzzle.hpp"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#define CLIENTSPERTHREAD 50
+#define PUZZLEPATH "./Assets/Puzzles/levels.epd"
+
+struct Options {
+    std::string host;
+    unsigned short port;
+    int clients;
+    float seconds;
+    int topPercent;
+    bool race;
+    int wrongPercent;
+};
+
+struct Result {
+    std::vector<sf::Int32> latencies;
+    int connected;
+    int errors;
+    int pushes;
+};
+
+PuzzlePack pack;
+
+//Reads until the wanted opcode arrives, counting the Progress pushes that come in between
+bool expect(sf::TcpSocket& socket, sf::Packet& packet, sf::Uint8 wanted, Result& result) {
+    sf::Uint8 op;
+
+    while (socket.receive(packet) == sf::Socket::Done && (packet >> op)) {
+        if (op == wanted)
+            return true;
+
+        if (op != Protocol::Progress)
+            return false;
+
+        result.pushes++;
+    }
+
+    return false;
+}
+
+//Every racer joins, waits for the start and then answers its slots as fast as verdicts come back,
+//mostly with the pack's solution and sometimes with a wrong move. The sockets of one thread can land in different
+//races, so each keeps the sequence of its own race
+void racer(const Options& options, std::vector<std::unique_ptr<sf::TcpSocket>>& sockets, int first, Result& result) {
+    sf::Packet request;
+    sf::Packet reply;
+    std::vector<std::vector<sf::Uint32>> sequences(sockets.size());
+    std::size_t longest = 0;
+    std::vector<sf::Int64> sent(sockets.size());
+    sf::Clock clock;
+
+    for (std::size_t i = 0; i < sockets.size(); i++) {
+        request.clear();
+        Protocol::join(request, 0, (sf::Uint32)(first + i));
+        sockets[i]->send(request);
+    }
+
+    for (std::size_t i = 0; i < sockets.size(); i++) {
+        sf::Uint32 sequenceNumber;
+        sf::Uint16 length;
+
+        if (!expect(*sockets[i], reply, Protocol::Start, result) || !(reply >> sequenceNumber >> length)) {
+            result.errors++;
+            return;
+        }
+
+        sequences[i].resize(length);
+        longest = std::max<std::size_t>(longest, length);
+
+        for (sf::Uint16 s = 0; s < length; s++)
+            reply >> sequences[i][s];
+    }
+
+    clock.restart();
+
+    for (sf::Uint16 slot = 0; slot < longest && clock.getElapsedTime().asSeconds() < options.seconds; slot++) {
+        for (std::size_t i = 0; i < sockets.size(); i++) {
+            sent[i] = -1;
+
+            if (slot >= sequences[i].size())
+                continue;
+
+            const Puzzle& puzzle = pack.puzzles[sequences[i][slot] % pack.size()];
+            std::string move = rand() % 100 < options.wrongPercent ? "0000" : Chess::uci(puzzle.best[0]);
+            request.clear();
+            Protocol::answer(request, slot, slot, move);
+            sent[i] = clock.getElapsedTime().asMicroseconds();
+
+            if (sockets[i]->send(request) != sf::Socket::Done) {
+                result.errors++;
+                sent[i] = -1;
+            }
+        }
+
+        for (std::size_t i = 0; i < sockets.size(); i++) {
+            if (sent[i] < 0)
+                continue;
+
+            if (!expect(*sockets[i], reply, Protocol::Verdict, result)) {
+                result.errors++;
+                continue;
+            }
+
+            result.latencies.push_back((sf::Int32)(clock.getElapsedTime().asMicroseconds() - sent[i]));
+        }
+    }
+}
+
+//Every client keeps one request in flight: a thread sends for all of its clients, then collects every reply
+void worker(const Options& options, int first, int count, Result& result) {
+    std::vector<std::unique_ptr<sf::TcpSocket>> sockets;
+    sf::IpAddress host(options.host);
+
+    for (int i = 0; i < count; i++) {
+        std::unique_ptr<sf::TcpSocket> socket(new sf::TcpSocket);
+
+        if (socket->connect(host, options.port, sf::seconds(5.f)) == sf::Socket::Done)
+            sockets.push_back(std::move(socket));
+    }
+
+    result.connected = (int)sockets.size();
+    result.errors = 0;
+    result.pushes = 0;
+
+    if (options.race) {
+        racer(options, sockets, first, result);
+        return;
+    }
+
+    std::vector<sf::Int64> sent(sockets.size());
+    sf::Packet request;
+    sf::Packet reply;
+    sf::Uint32 sequence = 0;
+    sf::Clock clock;
+
+    while (!sockets.empty() && clock.getElapsedTime().asSeconds() < options.seconds) {
+        for (std::size_t i = 0; i < sockets.size(); i++) {
+            sf::Uint32 client = (sf::Uint32)(first + i);
+            request.clear();
+
+            if ((int)(sequence % 100) < options.topPercent)
+                Protocol::top(request, sequence, sequence % 5, 10);
+            else
+                Protocol::submit(request, sequence, client, sequence % 5, (float)(rand() % 30), rand() % 30);
+
+            sequence++;
+            sent[i] = clock.getElapsedTime().asMicroseconds();
+
+            if (sockets[i]->send(request) != sf::Socket::Done)
+                result.errors++;
+        }
+
+        for (std::size_t i = 0; i < sockets.size(); i++) {
+            sf::Uint8 op;
+
+            if (sockets[i]->receive(reply) != sf::Socket::Done || !(reply >> op) || op == Protocol::Rejected) {
+                result.errors++;
+                continue;
+            }
+
+            result.latencies.push_back((sf::Int32)(clock.getElapsedTime().asMicroseconds() - sent[i]));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options = { "127.0.0.1", SERVERPORT, 1000, 5.f, 20, false, 10 };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--race") == 0) {
+            options.race = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            break;
+
+        if (strcmp(argv[i], "--host") == 0)
+            options.host = argv[i + 1];
+        else if (strcmp(argv[i], "--port") == 0)
+            options.port = (unsigned short)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--clients") == 0)
+            options.clients = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seconds") == 0)
+            options.seconds = (float)atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--top") == 0)
+            options.topPercent = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--wrong") == 0)
+            options.wrongPercent = atoi(argv[i + 1]);
+
+        i++;
+    }
+
+    if (options.race && (!pack.load(PUZZLEPATH) || pack.size() == 0)) {
+        printf("Race mode needs %s\n", PUZZLEPATH);
+        return 1;
+    }
+
+#ifdef __linux__
+    rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+
+    int threads = (options.clients + CLIENTSPERTHREAD - 1) / CLIENTSPERTHREAD;
+    std::vector<Result> results(threads);
+    std::vector<std::thread> workers;
+    sf::Clock clock;
+
+    for (int t = 0; t < threads; t++) {
+        int first = t * CLIENTSPERTHREAD;
+        workers.push_back(std::thread(worker, std::cref(options), first, std::min(CLIENTSPERTHREAD, options.clients - first), std::ref(results[t])));
+    }
+
+    for (std::size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    float elapsed = clock.getElapsedTime().asSeconds();
+    std::vector<sf::Int32> latencies;
+    int connected = 0;
+    int errors = 0;
+    int pushes = 0;
+
+    for (std::size_t t = 0; t < results.size(); t++) {
+        latencies.insert(latencies.end(), results[t].latencies.begin(), results[t].latencies.end());
+        connected += results[t].connected;
+        errors += results[t].errors;
+        pushes += results[t].pushes;
+    }
+
+    if (latencies.empty()) {
+        printf("No replies from %s:%u\n", options.host.c_str(), options.port);
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("%d/%d clients connected, %zu requests in %.1f s, %d errors\n", connected, options.clients, latencies.size(), elapsed, errors);
+    if (options.race)
+        printf("%d progress pushes received\n", pushes);
+
+    printf("%.0f requests/s, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", latencies.size() / elapsed,
+        latencies[latencies.size() / 2] / 1000.0, latencies[latencies.size() * 99 / 100] / 1000.0, latencies.back() / 1000.0);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile() :
+    bytes(nullptr), length(0),
+#ifdef _WIN32
+    file(INVALID_HANDLE_VALUE), mapping(nullptr)
+#else
+    file(-1)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    bytes = mapping ? (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    length = (std::size_t)fileSize.QuadPart;
+#else
+    file = ::open(path.c_str(), O_RDONLY);
+
+    if (file < 0)
+        return false;
+
+    struct stat info;
+
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        close();
+        return false;
+    }
+
+    void* view = mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    bytes = view == MAP_FAILED ? nullptr : (const unsigned char*)view;
+    length = (std::size_t)info.st_size;
+#endif
+
+    if (bytes == nullptr) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (bytes)
+        UnmapViewOfFile(bytes);
+
+    if (mapping)
+        CloseHandle(mapping);
+
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (bytes)
+        munmap((void*)bytes, length);
+
+    if (file >= 0)
+        ::close(file);
+
+    file = -1;
+#endif
+
+    bytes = nullptr;
+    length = 0;
+}
@@ -0,0 +1,246 @@
+#include "Mate.hpp"
+#include <algorithm>
+
+namespace Chess {
+    namespace {
+        const std::uint32_t INFINITE_PROOF = 100000000;
+
+        //Sums saturate below infinity so only a real disproof or proof ever reaches it
+        std::uint32_t add(std::uint32_t a, std::uint32_t b) {
+            if (a >= INFINITE_PROOF || b >= INFINITE_PROOF)
+                return INFINITE_PROOF;
+
+            return std::min(a + b, INFINITE_PROOF - 1);
+        }
+    }
+
+    MateSolver::MateSolver() :
+        table(MATETABLE), nodes(0), budget(0)
+    {}
+
+    //Buckets of two entries: a position is looked up in both and a store always lands in one of them,
+    //otherwise a parent could keep re-expanding a child whose result never reaches the table
+    MateSolver::Entry* MateSolver::bucket(std::uint64_t key, int plies) {
+        return &table[(key ^ ((std::uint64_t)plies * 0x9e3779b97f4a7c15ull)) & (table.size() - 2)];
+    }
+
+    void MateSolver::lookup(std::uint64_t key, int plies, std::uint32_t& proof, std::uint32_t& disproof) {
+        Entry* b = bucket(key, plies);
+
+        for (int i = 0; i < 2; i++) {
+            if (b[i].key == key && b[i].plies == plies) {
+                proof = b[i].proof;
+                disproof = b[i].disproof;
+                return;
+            }
+        }
+
+        proof = 1;
+        disproof = 1;
+    }
+
+    //A solved entry is kept over an open one when the bucket is full
+    void MateSolver::store(std::uint64_t key, int plies, std::uint32_t proof, std::uint32_t disproof) {
+        Entry* b = bucket(key, plies);
+        Entry* e = &b[1];
+
+        if (b[0].key == key && b[0].plies == plies)
+            e = &b[0];
+        else if (!(b[1].key == key && b[1].plies == plies) && (b[0].plies < 0 || (b[0].proof != 0 && b[0].disproof != 0)))
+            e = &b[0];
+
+        e->key = key;
+        e->plies = plies;
+        e->proof = proof;
+        e->disproof = disproof;
+    }
+
+    //The attacker moves when an odd number of plies is left. Its proof number is the smallest among the replies and its
+    //disproof number their sum, the other way round for the defender. The most proving child is searched with
+    //thresholds that send control back as soon as a sibling would become the better choice
+    void MateSolver::mid(Position& position, int plies, std::uint32_t proofLimit, std::uint32_t disproofLimit) {
+        nodes++;
+        bool attacker = (plies & 1) != 0;
+        std::uint64_t key = position.key();
+
+        if (plies == 0 && !position.inCheck()) {
+            store(key, plies, INFINITE_PROOF, 0);
+            return;
+        }
+
+        MoveList list;
+        position.generate(list);
+
+        //Mate is a proof only when the defender is the one mated, a stalemate or running out of plies is an escape
+        if (list.size == 0 || plies == 0) {
+            if (list.size == 0 && !attacker && position.inCheck())
+                store(key, plies, 0, INFINITE_PROOF);
+            else
+                store(key, plies, INFINITE_PROOF, 0);
+
+            return;
+        }
+
+        std::uint64_t keys[256];
+        Undo undo;
+
+        for (int i = 0; i < list.size; i++) {
+            position.make(list.moves[i], undo);
+            keys[i] = position.key();
+            position.unmake(list.moves[i], undo);
+        }
+
+        while (nodes < budget) {
+            std::uint32_t proof = attacker ? INFINITE_PROOF : 0;
+            std::uint32_t disproof = attacker ? 0 : INFINITE_PROOF;
+            std::uint32_t bestValue = INFINITE_PROOF + 1;
+            std::uint32_t second = INFINITE_PROOF;
+            std::uint32_t childProof = 0;
+            std::uint32_t childDisproof = 0;
+            int best = 0;
+
+            for (int i = 0; i < list.size; i++) {
+                std::uint32_t p, d;
+                lookup(keys[i], plies - 1, p, d);
+                std::uint32_t value = attacker ? p : d;
+
+                if (attacker) {
+                    proof = std::min(proof, p);
+                    disproof = add(disproof, d);
+                }
+                else {
+                    proof = add(proof, p);
+                    disproof = std::min(disproof, d);
+                }
+
+                if (value < bestValue) {
+                    second = bestValue;
+                    bestValue = value;
+                    best = i;
+                    childProof = p;
+                    childDisproof = d;
+                }
+                else if (value < second) {
+                    second = value;
+                }
+            }
+
+            if (proof >= proofLimit || disproof >= disproofLimit) {
+                store(key, plies, proof, disproof);
+                return;
+            }
+
+            second = std::min(second, INFINITE_PROOF - 1);
+            position.make(list.moves[best], undo);
+
+            if (attacker)
+                mid(position, plies - 1, std::min(proofLimit, second + 1), disproofLimit - disproof + childDisproof);
+            else
+                mid(position, plies - 1, proofLimit - proof + childProof, std::min(disproofLimit, second + 1));
+
+            position.unmake(list.moves[best], undo);
+        }
+    }
+
+    bool MateSolver::prove(Position& position, int plies) {
+        std::uint32_t proof, disproof;
+
+        while (true) {
+            lookup(position.key(), plies, proof, disproof);
+
+            if (proof == 0 || disproof == 0 || nodes >= budget)
+                return proof == 0;
+
+            mid(position, plies, INFINITE_PROOF, INFINITE_PROOF);
+        }
+    }
+
+    MateResult MateSolver::solve(const Position& position, int maxMoves, std::uint64_t nodeBudget) {
+        MateResult result;
+        result.moves = 0;
+        result.exhausted = false;
+
+        Entry empty = { 0, 0, 0, -1 };
+        std::fill(table.begin(), table.end(), empty);
+        nodes = 0;
+        budget = nodeBudget;
+
+        Position root = position;
+
+        for (int n = 1; n <= maxMoves && result.moves == 0; n++) {
+            if (prove(root, 2 * n - 1))
+                result.moves = n;
+            else if (nodes >= budget)
+                break;
+        }
+
+        if (result.moves > 0) {
+            MoveList list;
+            Undo undo;
+            root.generate(list);
+
+            for (int i = 0; i < list.size; i++) {
+                root.make(list.moves[i], undo);
+
+                if (prove(root, 2 * result.moves - 2))
+                    result.mating.push_back(list.moves[i]);
+
+                root.unmake(list.moves[i], undo);
+            }
+        }
+
+        result.exhausted = nodes >= budget;
+        result.nodes = nodes;
+        return result;
+    }
+
+    //A main line for a mate in moves: the attacker plays first and then the first mating move the solver lists, the
+    //defender the first reply that is not mated a move sooner, which is one of the longest defences.
+    //The line stops early when the solver runs out of nodes
+    std::vector<Move> MateSolver::line(const Position& position, int moves, Move first, std::uint64_t nodeBudget) {
+        std::vector<Move> result;
+        Position p = position;
+        Undo undo;
+
+        for (int n = moves; n >= 1; n--) {
+            Move attack = first;
+
+            if (n < moves) {
+                MateResult mate = solve(p, n, nodeBudget);
+
+                if (mate.moves == 0)
+                    break;
+
+                attack = mate.mating[0];
+            }
+
+            result.push_back(attack);
+            p.make(attack, undo);
+
+            MoveList list;
+            p.generate(list);
+
+            if (list.size == 0)
+                break;
+
+            Move defence = list.moves[0];
+
+            for (int i = 0; i < list.size && n > 2; i++) {
+                Undo reply;
+                p.make(list.moves[i], reply);
+                bool sooner = solve(p, n - 2, nodeBudget).moves != 0;
+                p.unmake(list.moves[i], reply);
+
+                if (!sooner) {
+                    defence = list.moves[i];
+                    break;
+                }
+            }
+
+            result.push_back(defence);
+            p.make(defence, undo);
+        }
+
+        return result;
+    }
+}
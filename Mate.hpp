@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Chess.hpp"
+
+#define MAXMATE 8
+#define MATEBUDGET 4000000
+#define MATETABLE (1 << 20)
+
+namespace Chess {
+    //moves is 0 when no mate was proven, with exhausted telling a disproof apart from running out of nodes
+    struct MateResult {
+        int moves;
+        std::vector<Move> mating;
+        std::uint64_t nodes;
+        bool exhausted;
+    };
+
+    //Depth-first proof-number search for "mate in N". Proof and disproof numbers count the leaves still needed to show
+    //that the attacker mates or escapes, so the search follows forcing replies instead of a full-width tree.
+    //N grows one move at a time, which makes the first proof the shortest mate, and then every first move is tried
+    //against the same bound to list all mating moves. Results are kept per position and remaining depth.
+    class MateSolver {
+        struct Entry {
+            std::uint64_t key;
+            std::uint32_t proof;
+            std::uint32_t disproof;
+            std::int32_t plies;
+        };
+
+        std::vector<Entry> table;
+        std::uint64_t nodes;
+        std::uint64_t budget;
+
+        Entry* bucket(std::uint64_t key, int plies);
+        void lookup(std::uint64_t key, int plies, std::uint32_t& proof, std::uint32_t& disproof);
+        void store(std::uint64_t key, int plies, std::uint32_t proof, std::uint32_t disproof);
+        void mid(Position& position, int plies, std::uint32_t proofLimit, std::uint32_t disproofLimit);
+        bool prove(Position& position, int plies);
+
+    public:
+        MateSolver();
+
+        MateResult solve(const Position& position, int maxMoves = MAXMATE, std::uint64_t nodeBudget = MATEBUDGET);
+        std::vector<Move> line(const Position& position, int moves, Move first, std::uint64_t nodeBudget = MATEBUDGET);
+    };
+}
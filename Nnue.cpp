@@ -0,0 +1,238 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Nnue.hpp"
+#include <cstdio>
+#include <cstring>
+
+//The kernels pick AVX2, SSE2 or NEON when the target has it, define NNUE_SCALAR to force the plain loops
+#if !defined(NNUE_SCALAR) && defined(__AVX2__)
+#define NNUE_AVX2
+#include <immintrin.h>
+#elif !defined(NNUE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define NNUE_SSE
+#include <emmintrin.h>
+#elif !defined(NNUE_SCALAR) && (defined(__aarch64__) || defined(_M_ARM64))
+#define NNUE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Chess {
+    namespace {
+        //Hidden units clip to [0, ACTIVATION], the output is scaled back from ACTIVATION * OUTPUTSCALE to centipawns
+        const int ACTIVATION = 255;
+        const int OUTPUTSCALE = 64;
+        const int CENTIPAWNS = 400;
+
+        static_assert(NNUEHIDDEN % 16 == 0, "the kernels work in blocks of 16 units");
+
+        //The input for a piece on a square as side sees it: its own pieces come first and the board turns for black
+        inline int feature(Color side, Piece p, Square s) {
+            return side == White ? p * 64 + s : ((p + 6) % 12) * 64 + (s ^ 56);
+        }
+
+        void add(std::int16_t* values, const std::int16_t* column) {
+#if defined(NNUE_AVX2)
+            for (int i = 0; i < NNUEHIDDEN; i += 16) {
+                __m256i v = _mm256_load_si256((const __m256i*)(values + i));
+                _mm256_store_si256((__m256i*)(values + i), _mm256_add_epi16(v, _mm256_loadu_si256((const __m256i*)(column + i))));
+            }
+#elif defined(NNUE_SSE)
+            for (int i = 0; i < NNUEHIDDEN; i += 8) {
+                __m128i v = _mm_load_si128((const __m128i*)(values + i));
+                _mm_store_si128((__m128i*)(values + i), _mm_add_epi16(v, _mm_loadu_si128((const __m128i*)(column + i))));
+            }
+#elif defined(NNUE_NEON)
+            for (int i = 0; i < NNUEHIDDEN; i += 8)
+                vst1q_s16(values + i, vaddq_s16(vld1q_s16(values + i), vld1q_s16(column + i)));
+#else
+            for (int i = 0; i < NNUEHIDDEN; i++)
+                values[i] += column[i];
+#endif
+        }
+
+        void subtract(std::int16_t* values, const std::int16_t* column) {
+#if defined(NNUE_AVX2)
+            for (int i = 0; i < NNUEHIDDEN; i += 16) {
+                __m256i v = _mm256_load_si256((const __m256i*)(values + i));
+                _mm256_store_si256((__m256i*)(values + i), _mm256_sub_epi16(v, _mm256_loadu_si256((const __m256i*)(column + i))));
+            }
+#elif defined(NNUE_SSE)
+            for (int i = 0; i < NNUEHIDDEN; i += 8) {
+                __m128i v = _mm_load_si128((const __m128i*)(values + i));
+                _mm_store_si128((__m128i*)(values + i), _mm_sub_epi16(v, _mm_loadu_si128((const __m128i*)(column + i))));
+            }
+#elif defined(NNUE_NEON)
+            for (int i = 0; i < NNUEHIDDEN; i += 8)
+                vst1q_s16(values + i, vsubq_s16(vld1q_s16(values + i), vld1q_s16(column + i)));
+#else
+            for (int i = 0; i < NNUEHIDDEN; i++)
+                values[i] -= column[i];
+#endif
+        }
+
+        //Sum of clipped units times their weights, products are paired into 32 bits before they are added up
+        std::int32_t dot(const std::int16_t* values, const std::int16_t* weights) {
+#if defined(NNUE_AVX2)
+            __m256i zero = _mm256_setzero_si256();
+            __m256i top = _mm256_set1_epi16(ACTIVATION);
+            __m256i sum = _mm256_setzero_si256();
+
+            for (int i = 0; i < NNUEHIDDEN; i += 16) {
+                __m256i v = _mm256_min_epi16(_mm256_max_epi16(_mm256_load_si256((const __m256i*)(values + i)), zero), top);
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, _mm256_loadu_si256((const __m256i*)(weights + i))));
+            }
+
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+            return _mm_cvtsi128_si32(half);
+#elif defined(NNUE_SSE)
+            __m128i zero = _mm_setzero_si128();
+            __m128i top = _mm_set1_epi16(ACTIVATION);
+            __m128i sum = _mm_setzero_si128();
+
+            for (int i = 0; i < NNUEHIDDEN; i += 8) {
+                __m128i v = _mm_min_epi16(_mm_max_epi16(_mm_load_si128((const __m128i*)(values + i)), zero), top);
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i*)(weights + i))));
+            }
+
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            return _mm_cvtsi128_si32(sum);
+#elif defined(NNUE_NEON)
+            int16x8_t zero = vdupq_n_s16(0);
+            int16x8_t top = vdupq_n_s16(ACTIVATION);
+            int32x4_t sum = vdupq_n_s32(0);
+
+            for (int i = 0; i < NNUEHIDDEN; i += 8) {
+                int16x8_t v = vminq_s16(vmaxq_s16(vld1q_s16(values + i), zero), top);
+                int16x8_t w = vld1q_s16(weights + i);
+                sum = vmlal_s16(sum, vget_low_s16(v), vget_low_s16(w));
+                sum = vmlal_s16(sum, vget_high_s16(v), vget_high_s16(w));
+            }
+
+            return vaddvq_s32(sum);
+#else
+            std::int32_t sum = 0;
+
+            for (int i = 0; i < NNUEHIDDEN; i++) {
+                int v = values[i] < 0 ? 0 : values[i] > ACTIVATION ? ACTIVATION : values[i];
+                sum += v * weights[i];
+            }
+
+            return sum;
+#endif
+        }
+    }
+
+    Network::Network() :
+        outputBias(0), ready(false)
+    {}
+
+    Network& Network::instance() {
+        static Network network;
+        return network;
+    }
+
+    const char* Network::kernels() {
+#if defined(NNUE_AVX2)
+        return "avx2";
+#elif defined(NNUE_SSE)
+        return "sse2";
+#elif defined(NNUE_NEON)
+        return "neon";
+#else
+        return "scalar";
+#endif
+    }
+
+    //A file of the wrong size or for another hidden layer leaves the network unloaded, evaluation then stays classical
+    bool Network::load(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "rb");
+        char magic[4];
+        std::uint32_t version = 0, hidden = 0;
+
+        ready = false;
+
+        if (file == nullptr)
+            return false;
+
+        weights.assign(NNUEINPUTS * NNUEHIDDEN, 0);
+        biases.assign(NNUEHIDDEN, 0);
+        output.assign(2 * NNUEHIDDEN, 0);
+
+        bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "BMNN", 4) == 0 &&
+            fread(&version, sizeof(version), 1, file) == 1 && version == NNUEVERSION &&
+            fread(&hidden, sizeof(hidden), 1, file) == 1 && hidden == NNUEHIDDEN &&
+            fread(weights.data(), sizeof(std::int16_t), weights.size(), file) == weights.size() &&
+            fread(biases.data(), sizeof(std::int16_t), biases.size(), file) == biases.size() &&
+            fread(output.data(), sizeof(std::int16_t), output.size(), file) == output.size() &&
+            fread(&outputBias, sizeof(outputBias), 1, file) == 1 &&
+            fgetc(file) == EOF;
+
+        fclose(file);
+        ready = ok;
+        return ok;
+    }
+
+    //Small random weights of the right shape, for timing the kernels where no trained network is at hand
+    void Network::randomize(std::uint32_t seed) {
+        auto random = [&seed](int range) {
+            seed = seed * 1664525u + 1013904223u;
+            return (int)((seed >> 16) % (2 * range + 1)) - range;
+        };
+
+        weights.resize(NNUEINPUTS * NNUEHIDDEN);
+        biases.resize(NNUEHIDDEN);
+        output.resize(2 * NNUEHIDDEN);
+
+        for (std::int16_t& w : weights)
+            w = (std::int16_t)random(32);
+
+        for (std::int16_t& b : biases)
+            b = (std::int16_t)random(64);
+
+        for (std::int16_t& w : output)
+            w = (std::int16_t)random(64);
+
+        outputBias = random(1000);
+        ready = true;
+    }
+
+    void Network::refresh(const Position& position, Accumulator& out) const {
+        for (int side = White; side <= Black; side++) {
+            memcpy(out.values[side], biases.data(), sizeof(out.values[side]));
+
+            for (Bitboard b = position.pieces(); b; b &= b - 1) {
+                Square s = lsb(b);
+                add(out.values[side], &weights[feature((Color)side, position.pieceOn(s), s) * NNUEHIDDEN]);
+            }
+        }
+    }
+
+    //Replays the changes of the move that led to after on a copy of the parent's accumulator
+    void Network::update(const Accumulator& before, const Position& after, Accumulator& out) const {
+        int count;
+        const PieceChange* changes = after.changed(count);
+        out = before;
+
+        for (int side = White; side <= Black; side++) {
+            for (int i = 0; i < count; i++) {
+                const PieceChange& c = changes[i];
+
+                if (c.from != NO_SQUARE)
+                    subtract(out.values[side], &weights[feature((Color)side, c.piece, c.from) * NNUEHIDDEN]);
+
+                if (c.to != NO_SQUARE)
+                    add(out.values[side], &weights[feature((Color)side, c.piece, c.to) * NNUEHIDDEN]);
+            }
+        }
+    }
+
+    int Network::evaluate(const Accumulator& accumulator, Color side) const {
+        std::int32_t sum = outputBias + dot(accumulator.values[side], output.data()) + dot(accumulator.values[side ^ 1], output.data() + NNUEHIDDEN);
+        return (int)((std::int64_t)sum * CENTIPAWNS / (ACTIVATION * OUTPUTSCALE));
+    }
+}
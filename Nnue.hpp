@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Chess.hpp"
+
+#define NNUEPATH "./Assets/Networks/eval.nnue"
+#define NNUEHIDDEN 128
+#define NNUEINPUTS 768
+#define NNUEVERSION 1
+
+namespace Chess {
+    //First layer outputs for both sides' points of view, the one for white first
+    struct Accumulator {
+        alignas(32) std::int16_t values[2][NNUEHIDDEN];
+    };
+
+    //768 piece-square inputs per point of view into NNUEHIDDEN clipped ReLU units, both halves into one output, the
+    //side to move's half first. Each side sees the board as if it were white, so one set of weights serves both.
+    //The first layer is a sum of weight columns, so a move only adds and subtracts the columns of the pieces it touched.
+    //File layout, little endian: "BMNN", version, hidden size, then int16 input weights by input, int16 biases,
+    //int16 output weights and an int32 output bias
+    class Network {
+        std::vector<std::int16_t> weights;
+        std::vector<std::int16_t> biases;
+        std::vector<std::int16_t> output;
+        std::int32_t outputBias;
+        bool ready;
+
+        Network();
+
+    public:
+        static Network& instance();
+        static const char* kernels();
+
+        bool load(const std::string& path);
+        void randomize(std::uint32_t seed);
+        bool loaded() const { return ready; }
+
+        void refresh(const Position& position, Accumulator& out) const;
+        void update(const Accumulator& before, const Position& after, Accumulator& out) const;
+        int evaluate(const Accumulator& accumulator, Color side) const;
+    };
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <SFML/Network.hpp>
+
+#define SERVERPORT 53000
+#define MAXFRAME 65536
+#define MAXLEADERS 100
+#define RACETICK 0.1f
+#define RACELEADERS 10
+
+//Every message is an sf::Packet behind a 4 byte big-endian length, the framing sf::TcpSocket already uses,
+//so clients send and receive plain packets while the epoll server frames the bytes itself
+namespace Protocol {
+    enum OPCODE : sf::Uint8 {
+        Submit,
+        Top,
+        Accepted,
+        Leaders,
+        Rejected,
+        Join,
+        Start,
+        Answer,
+        Verdict,
+        Progress
+    };
+
+    struct Entry {
+        sf::Uint32 player;
+        sf::Int32 score;
+        float seconds;
+    };
+
+    inline sf::Packet& operator<<(sf::Packet& packet, const Entry& e) {
+        return packet << e.player << e.score << e.seconds;
+    }
+
+    inline sf::Packet& operator>>(sf::Packet& packet, Entry& e) {
+        return packet >> e.player >> e.score >> e.seconds;
+    }
+
+    //Requests carry a client chosen sequence number that the reply echoes back
+    inline void submit(sf::Packet& packet, sf::Uint32 sequence, sf::Uint32 player, sf::Uint32 puzzle, float seconds, sf::Int32 score) {
+        packet << (sf::Uint8)Submit << sequence << player << puzzle << seconds << score;
+    }
+
+    inline void top(sf::Packet& packet, sf::Uint32 sequence, sf::Uint32 puzzle, sf::Uint8 count) {
+        packet << (sf::Uint8)Top << sequence << puzzle << count;
+    }
+
+    //Race messages: Join waits for a Start carrying the puzzle sequence, every Answer gets a Verdict,
+    //and Progress with the leading racers is pushed at most once per RACETICK
+    inline void join(sf::Packet& packet, sf::Uint32 sequence, sf::Uint32 player) {
+        packet << (sf::Uint8)Join << sequence << player;
+    }
+
+    inline void answer(sf::Packet& packet, sf::Uint32 sequence, sf::Uint16 slot, const std::string& move) {
+        packet << (sf::Uint8)Answer << sequence << slot << move;
+    }
+
+    inline void frame(const sf::Packet& packet, std::vector<char>& out) {
+        sf::Uint32 size = (sf::Uint32)packet.getDataSize();
+        char header[4] = { (char)(size >> 24), (char)(size >> 16), (char)(size >> 8), (char)size };
+
+        out.insert(out.end(), header, header + 4);
+        out.insert(out.end(), (const char*)packet.getData(), (const char*)packet.getData() + size);
+    }
+
+    //Pulls the next whole frame out of the buffer from offset, Incomplete leaves offset alone until more bytes arrive
+    enum UNFRAME {
+        Complete,
+        Incomplete,
+        Malformed
+    };
+
+    inline UNFRAME unframe(const std::vector<char>& in, std::size_t& offset, sf::Packet& packet) {
+        if (in.size() - offset < 4)
+            return Incomplete;
+
+        const unsigned char* header = (const unsigned char*)&in[offset];
+        sf::Uint32 size = ((sf::Uint32)header[0] << 24) | ((sf::Uint32)header[1] << 16) | ((sf::Uint32)header[2] << 8) | header[3];
+
+        if (size > MAXFRAME)
+            return Malformed;
+
+        if (in.size() - offset - 4 < size)
+            return Incomplete;
+
+        packet.clear();
+
+        if (size > 0)
+            packet.append(&in[offset + 4], size);
+
+        offset += 4 + size;
+        return Complete;
+    }
+}
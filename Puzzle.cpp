@@ -0,0 +1,307 @@
+#include "Puzzle.hpp"
+#include "Tablebase.hpp"
+#include "Mate.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+    //The defender's longest resistance and the attacker's fastest win, both read straight from the tablebases
+    Chess::Move tablebaseReply(Chess::Position position) {
+        Chess::MoveList list;
+        Chess::Undo undo;
+        Chess::Move best = Chess::NO_MOVE;
+        int bestScore = 0;
+        position.generate(list);
+
+        for (int i = 0; i < list.size; i++) {
+            Chess::TbResult r;
+            position.make(list.moves[i], undo);
+            bool found = Chess::Tablebases::instance().probe(position, r);
+            position.unmake(list.moves[i], undo);
+
+            if (!found)
+                continue;
+
+            int score = r.wdl > 0 ? -1000 + r.plies : r.wdl < 0 ? 1000 - r.plies : 0;
+
+            if (best == Chess::NO_MOVE || score > bestScore) {
+                best = list.moves[i];
+                bestScore = score;
+            }
+        }
+
+        return best;
+    }
+}
+
+//A move in the solution tree always solves, and so does any other move that mates on the spot. Once the position is
+//in the tablebases any move that keeps the result does too, and one that keeps the shortest mate when the puzzle asks
+//for it with dm
+bool Puzzle::accepts(Chess::Move m) const {
+    for (int i = 1; i < (int)solution.size() && i <= solution[0].count; i++)
+        if (solution[i].move == m)
+            return true;
+
+    return step(0, position, m).correct;
+}
+
+//The tree is tried first, the tablebases take over when they know the position and the line goes on. Only a mate
+//puzzle whose tree stops short of the mate asks the mate solver, a tagged pack is all lookups
+PuzzleStep Puzzle::step(int node, const Chess::Position& current, Chess::Move m) const {
+    PuzzleStep result = { false, false, Chess::NO_MOVE, -1 };
+    int child = -1;
+
+    if (m == Chess::NO_MOVE)
+        return result;
+
+    if (node >= 0 && node < (int)solution.size())
+        for (int i = solution[node].first; i < solution[node].first + solution[node].count; i++)
+            if (solution[i].move == m)
+                child = i;
+
+    if (child >= 0 && solution[child].count > 0) {
+        result.correct = true;
+        result.node = solution[child].first;
+        result.reply = solution[result.node].move;
+        return result;
+    }
+
+    Chess::Position p = current;
+    Chess::MoveList list;
+    p.generate(list);
+
+    if (std::find(list.moves, list.moves + list.size, m) == list.moves + list.size)
+        return result;
+
+    Chess::TbResult root, after;
+    bool probed = Chess::Tablebases::instance().probe(p, root);
+
+    Chess::Undo undo;
+    p.make(m, undo);
+
+    if (p.checkmate()) {
+        result.correct = true;
+        result.solved = true;
+        return result;
+    }
+
+    if (probed && Chess::Tablebases::instance().probe(p, after) && after.wdl == -root.wdl &&
+        (root.wdl <= 0 || operation("dm").empty() || after.plies == root.plies - 1)) {
+        result.correct = true;
+        result.reply = tablebaseReply(p);
+        result.solved = result.reply == Chess::NO_MOVE || root.wdl <= 0;
+        return result;
+    }
+
+    //A leaf of a mate puzzle is right but not the end, the solver's line gives the defence. Off the tree a move is right
+    //when it is one of the shortest mates
+    int moves = atoi(operation("dm").c_str());
+
+    if (moves > 1 && (child >= 0 || node < 0)) {
+        Chess::MateSolver solver;
+        Chess::MateResult mate = solver.solve(current, moves);
+        result.correct = child >= 0 || std::find(mate.mating.begin(), mate.mating.end(), m) != mate.mating.end();
+
+        if (result.correct) {
+            std::vector<Chess::Move> line = solver.line(current, mate.moves > 0 ? mate.moves : moves, m);
+            result.reply = line.size() > 1 ? line[1] : Chess::NO_MOVE;
+            result.solved = result.reply == Chess::NO_MOVE;
+        }
+
+        return result;
+    }
+
+    result.correct = child >= 0;
+    result.solved = result.correct;
+    return result;
+}
+
+//The move the tree expects from the player at a node, the first one listed
+Chess::Move Puzzle::expected(int node) const {
+    if (node < 0 || node >= (int)solution.size() || solution[node].count == 0)
+        return Chess::NO_MOVE;
+
+    return solution[solution[node].first].move;
+}
+
+std::string Puzzle::operation(const std::string& opcode) const {
+    auto it = operations.find(opcode);
+    return it == operations.end() ? std::string() : it->second;
+}
+
+//Writes the position back in EPD form, string operands are quoted again
+std::string Puzzle::epd() const {
+    std::string fen = position.fen();
+    std::string text = fen.substr(0, fen.rfind(' ', fen.rfind(' ') - 1));
+
+    for (auto it = operations.begin(); it != operations.end(); ++it) {
+        bool quoted = it->first == "id" || it->first == "c0";
+        text += ' ' + it->first;
+
+        if (!it->second.empty())
+            text += quoted ? " \"" + it->second + "\"" : ' ' + it->second;
+
+        text += ';';
+    }
+
+    return text;
+}
+
+bool PuzzlePack::parse(const std::string& line, Puzzle& out) {
+    std::istringstream in(line);
+    std::string fields[4];
+
+    if (!(in >> fields[0] >> fields[1] >> fields[2] >> fields[3]))
+        return false;
+
+    if (!out.position.fromFen(fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' + fields[3]))
+        return false;
+
+    out.operations.clear();
+    out.best.clear();
+
+    std::string rest;
+    std::getline(in, rest);
+
+    //Operations end at a semicolon outside quotes, the first word is the opcode
+    std::string operation;
+    bool quoted = false;
+
+    for (std::size_t i = 0; i <= rest.size(); i++) {
+        char c = i < rest.size() ? rest[i] : ';';
+
+        if (c == '"') {
+            quoted = !quoted;
+            continue;
+        }
+
+        if (c != ';' || quoted) {
+            operation += c;
+            continue;
+        }
+
+        std::istringstream words(operation);
+        std::string opcode, operand, word;
+        words >> opcode;
+
+        while (words >> word)
+            operand += (operand.empty() ? "" : " ") + word;
+
+        if (!opcode.empty())
+            out.operations[opcode] = operand;
+
+        operation.clear();
+    }
+
+    out.id = out.operation("id");
+
+    std::istringstream moves(out.operation("bm"));
+    std::string san;
+
+    while (moves >> san) {
+        Chess::Move m = out.position.parseSan(san);
+
+        if (m == Chess::NO_MOVE)
+            return false;
+
+        out.best.push_back(m);
+    }
+
+    //The pv is the main line and "lines" holds one more per bm move, comma separated. Every line starts at the root and
+    //gives the player's first move a branch, a bm move that no line starts with stays a leaf
+    std::vector<std::vector<Chess::Move>> variations(1);
+    std::string text = out.operation("pv") + ',' + out.operation("lines") + ',';
+    std::string part;
+
+    for (char c : text) {
+        if (c == ',') {
+            Chess::Position position = out.position;
+            Chess::Undo undo;
+            std::istringstream words(part);
+            std::string word;
+            part.clear();
+
+            while (words >> word) {
+                Chess::Move m = position.parseSan(word);
+
+                if (m == Chess::NO_MOVE)
+                    return false;
+
+                variations.back().push_back(m);
+                position.make(m, undo);
+            }
+
+            if (!variations.back().empty())
+                variations.emplace_back();
+        }
+        else {
+            part += c;
+        }
+    }
+
+    variations.pop_back();
+
+    //The bm moves are the root's children, a line that starts elsewhere adds its first move to them
+    std::vector<Chess::Move> first = out.best;
+
+    for (const std::vector<Chess::Move>& variation : variations)
+        if (std::find(first.begin(), first.end(), variation[0]) == first.end())
+            first.push_back(variation[0]);
+
+    out.solution.clear();
+    out.solution.push_back(SolutionNode{ Chess::NO_MOVE, 1, (std::uint16_t)first.size() });
+
+    for (Chess::Move m : first)
+        out.solution.push_back(SolutionNode{ m, 0, 0 });
+
+    for (const std::vector<Chess::Move>& variation : variations) {
+        std::size_t parent = 1 + (std::find(first.begin(), first.end(), variation[0]) - first.begin());
+
+        if (out.solution[parent].count > 0)
+            continue;
+
+        for (std::size_t i = 1; i < variation.size(); i++) {
+            out.solution[parent].first = (std::uint16_t)out.solution.size();
+            out.solution[parent].count = 1;
+            parent = out.solution.size();
+            out.solution.push_back(SolutionNode{ variation[i], 0, 0 });
+        }
+    }
+
+    return true;
+}
+
+bool PuzzlePack::load(const std::string& path) {
+    std::ifstream file(path);
+
+    if (!file)
+        return false;
+
+    std::string line;
+    Puzzle puzzle;
+
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (parse(line, puzzle))
+            puzzles.push_back(puzzle);
+    }
+
+    return true;
+}
+
+bool PuzzlePack::save(const std::string& path) const {
+    std::ofstream file(path);
+
+    for (std::size_t i = 0; i < puzzles.size() && file; i++)
+        file << puzzles[i].epd() << '\n';
+
+    return (bool)file;
+}
+
+std::size_t PuzzlePack::size() const {
+    return puzzles.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "Chess.hpp"
+
+//One ply of a solution. The children of a node sit next to each other in the flat array: the moves the player may
+//answer with, or the one reply the opponent makes. Node 0 is the puzzle position itself
+struct SolutionNode {
+    Chess::Move move;
+    std::uint16_t first;
+    std::uint16_t count;
+};
+
+//What a player move does: correct or not, whether it ends the puzzle, and otherwise the reply to play and the node
+//the player continues from. node is -1 once the line has left the tree and only the tablebases or the mate solver judge
+//the moves
+struct PuzzleStep {
+    bool correct;
+    bool solved;
+    Chess::Move reply;
+    int node;
+};
+
+//One EPD record: the position, its opcodes as written, and the bm moves resolved against the position. The solution
+//tree holds every bm move, with the pv and each of the "lines" continuing behind the move they start with
+struct Puzzle {
+    std::string id;
+    Chess::Position position;
+    std::vector<Chess::Move> best;
+    std::vector<SolutionNode> solution;
+    std::map<std::string, std::string> operations;
+
+    bool accepts(Chess::Move m) const;
+    PuzzleStep step(int node, const Chess::Position& current, Chess::Move m) const;
+    Chess::Move expected(int node) const;
+    std::string operation(const std::string& opcode) const;
+    std::string epd() const;
+};
+
+//Puzzles are read from EPD packs, one position per line with "bm" naming the solving moves
+class PuzzlePack {
+public:
+    std::vector<Puzzle> puzzles;
+
+    static bool parse(const std::string& line, Puzzle& out);
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+    std::size_t size() const;
+};
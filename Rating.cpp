@@ -0,0 +1,226 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Rating.hpp"
+#include "FileSystem.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+    const float PI = 3.14159265f;
+    const float Q = 0.0057565f;
+
+    float g(float deviation) {
+        return 1.f / std::sqrt(1.f + 3.f * Q * Q * deviation * deviation / (PI * PI));
+    }
+
+    float expected(float rating, float opponent, float opponentDeviation) {
+        return 1.f / (1.f + std::pow(10.f, -g(opponentDeviation) * (rating - opponent) / 400.f));
+    }
+
+    //One Glicko-1 game against a single opponent, from the values both had before it
+    void rate(Rating& r, const Rating& opponent, float score) {
+        float e = expected(r.rating, opponent.rating, opponent.deviation);
+        float gj = g(opponent.deviation);
+        float d2 = 1.f / (Q * Q * gj * gj * e * (1.f - e));
+        float precision = 1.f / (r.deviation * r.deviation) + 1.f / d2;
+
+        r.rating += Q / precision * gj * (score - e);
+        r.deviation = std::max(std::sqrt(1.f / precision), DEVIATIONMIN);
+    }
+}
+
+//Uncertainty grows by DEVIATIONGROWTH per rating period without games, up to where a new rating starts
+float Glicko::deviation(const Rating& r, std::int64_t now) {
+    float periods = r.timestamp == 0 ? 0.f : std::max(0.f, (float)(now - r.timestamp) / RATINGPERIOD);
+    return std::min(std::sqrt(r.deviation * r.deviation + DEVIATIONGROWTH * DEVIATIONGROWTH * periods), DEVIATIONDEFAULT);
+}
+
+//The puzzle is the player's opponent and scores the other way round
+void Glicko::update(Rating& player, Rating& puzzle, float score, std::int64_t now) {
+    player.deviation = deviation(player, now);
+    puzzle.deviation = deviation(puzzle, now);
+
+    Rating before = player;
+    rate(player, puzzle, score);
+    rate(puzzle, before, 1.f - score);
+
+    player.timestamp = now;
+    puzzle.timestamp = now;
+}
+
+void PuzzleIndex::build(const std::vector<Rating>& ratings) {
+    byRating.clear();
+    entries.clear();
+    entries.reserve(ratings.size());
+
+    for (std::uint32_t i = 0; i < ratings.size(); i++)
+        entries.push_back(byRating.emplace(ratings[i].rating, i));
+}
+
+void PuzzleIndex::update(std::uint32_t puzzle, float rating) {
+    byRating.erase(entries[puzzle]);
+    entries[puzzle] = byRating.emplace(rating, puzzle);
+}
+
+//Two cursors leave the target in both directions and the closer one moves next
+bool PuzzleIndex::nearest(float target, const std::function<bool(std::uint32_t)>& skip, std::uint32_t& out) const {
+    Map::const_iterator up = byRating.lower_bound(target);
+    Map::const_iterator down = up;
+
+    while (up != byRating.end() || down != byRating.begin()) {
+        bool below = down != byRating.begin() && (up == byRating.end() || target - std::prev(down)->first < up->first - target);
+        Map::const_iterator it = below ? --down : up++;
+
+        if (!skip(it->second)) {
+            out = it->second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+RatingStore::RatingStore(const std::string& directory) :
+    path(directory + "/ratings.journal"),
+    journal(nullptr)
+{
+    FileSystem::makeDirectory(directory);
+}
+
+RatingStore::~RatingStore() {
+    if (journal != nullptr)
+        fclose(journal);
+}
+
+void RatingStore::load(const PuzzlePack& pack) {
+    if (journal != nullptr)
+        fclose(journal);
+
+    players.clear();
+    puzzles.clear();
+    keys.clear();
+    byKey.clear();
+
+    //The same position twice in a pack is one puzzle to the journal, its records replay into the first
+    for (const ::Puzzle& p : pack.puzzles) {
+        int difficulty = atoi(p.operation("difficulty").c_str());
+        int dm = atoi(p.operation("dm").c_str());
+        Rating r = { difficulty > 0 ? (float)difficulty : dm > 0 ? 1100.f + 200.f * dm : RATINGDEFAULT, DEVIATIONDEFAULT, 0 };
+        std::uint64_t key = p.position.key();
+        keys.push_back((std::uint32_t)(key ^ key >> 32));
+        byKey.emplace(keys.back(), (std::uint32_t)puzzles.size());
+        puzzles.push_back(r);
+    }
+
+    replay();
+    index.build(puzzles);
+    journal = fopen(path.c_str(), "ab");
+}
+
+//Records for puzzles the pack no longer has are dropped, and so are the Puzzle records of older journals, which went
+//by the index in a pack that may since have been rewritten. A record torn by a crash ends the replay and the rewrite
+//cuts it off, appending behind it would shift every later record
+void RatingStore::replay() {
+    FILE* file = fopen(path.c_str(), "rb");
+    RatingRecord record;
+    std::size_t count = 0;
+
+    if (file == nullptr)
+        return;
+
+    fseek(file, 0, SEEK_END);
+    bool torn = ftell(file) % sizeof(RatingRecord) != 0;
+    fseek(file, 0, SEEK_SET);
+
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        Rating r = { record.rating, record.deviation, record.timestamp };
+        count++;
+
+        if (record.kind == Player)
+            players[record.id] = r;
+        else if (record.kind == PuzzleKey && byKey.count(record.id) > 0)
+            puzzles[byKey[record.id]] = r;
+    }
+
+    fclose(file);
+
+    std::size_t rated = players.size() + std::count_if(puzzles.begin(), puzzles.end(), [](const Rating& r) { return r.timestamp != 0; });
+
+    if (torn || count > 2 * rated)
+        compact();
+}
+
+//The journal is either the old one or the compacted one, a crash in between loses nothing
+void RatingStore::compact() {
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+
+    if (file == nullptr)
+        return;
+
+    bool ok = true;
+
+    for (auto it = players.begin(); it != players.end(); ++it) {
+        RatingRecord record = { Player, it->first, it->second.rating, it->second.deviation, it->second.timestamp };
+        ok = ok && fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+
+    for (std::uint32_t i = 0; i < puzzles.size(); i++) {
+        if (puzzles[i].timestamp == 0 || byKey[keys[i]] != i)
+            continue;
+
+        RatingRecord record = { PuzzleKey, keys[i], puzzles[i].rating, puzzles[i].deviation, puzzles[i].timestamp };
+        ok = ok && fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+
+    if (ok)
+        FileSystem::sync(file);
+
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || !FileSystem::replace(temporary, path))
+        std::remove(temporary.c_str());
+}
+
+void RatingStore::append(std::uint32_t kind, std::uint32_t id, const Rating& r) {
+    if (journal == nullptr)
+        return;
+
+    RatingRecord record = { kind, id, r.rating, r.deviation, r.timestamp };
+    fwrite(&record, sizeof(record), 1, journal);
+    fflush(journal);
+}
+
+Rating RatingStore::player(std::uint32_t id) const {
+    auto it = players.find(id);
+
+    if (it == players.end()) {
+        Rating fresh = { RATINGDEFAULT, DEVIATIONDEFAULT, 0 };
+        return fresh;
+    }
+
+    return it->second;
+}
+
+Rating RatingStore::puzzle(std::uint32_t id) const {
+    return puzzles[id];
+}
+
+void RatingStore::record(std::uint32_t player, std::uint32_t puzzle, bool solved, std::int64_t timestamp) {
+    if (puzzle >= puzzles.size())
+        return;
+
+    Rating& p = players.emplace(player, this->player(player)).first->second;
+    Glicko::update(p, puzzles[puzzle], solved ? 1.f : 0.f, timestamp);
+    index.update(puzzle, puzzles[puzzle].rating);
+
+    append(Player, player, p);
+    append(PuzzleKey, keys[puzzle], puzzles[puzzle]);
+}
+
+bool RatingStore::next(float target, const std::function<bool(std::uint32_t)>& skip, std::uint32_t& out) const {
+    return index.nearest(target, skip, out);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include "Puzzle.hpp"
+
+#define RATINGDEFAULT 1500.f
+#define DEVIATIONDEFAULT 350.f
+#define DEVIATIONMIN 40.f
+#define DEVIATIONGROWTH 35.f
+#define RATINGPERIOD 86400
+#define RATINGSPREAD 100.f
+
+//Glicko rating: deviation is the uncertainty around rating, and it grows back while nothing is played
+struct Rating {
+    float rating;
+    float deviation;
+    std::int64_t timestamp;
+};
+
+//One rating as it stood after an attempt, the journal holds these in order and the last one for an id wins
+struct RatingRecord {
+    std::uint32_t kind;
+    std::uint32_t id;
+    float rating;
+    float deviation;
+    std::int64_t timestamp;
+};
+
+static_assert(sizeof(RatingRecord) == 24, "RatingRecord is a file format");
+
+namespace Glicko {
+    float deviation(const Rating& r, std::int64_t now);
+    void update(Rating& player, Rating& puzzle, float score, std::int64_t now);
+}
+
+//Puzzles ordered by rating. A rating change moves one entry and the nearest puzzle to a target is a lower_bound and a
+//walk outward past the ones the caller skips, so neither depends on the size of the pack
+class PuzzleIndex {
+    typedef std::multimap<float, std::uint32_t> Map;
+
+    Map byRating;
+    std::vector<Map::iterator> entries;
+
+public:
+    void build(const std::vector<Rating>& ratings);
+    void update(std::uint32_t puzzle, float rating);
+    bool nearest(float target, const std::function<bool(std::uint32_t)>& skip, std::uint32_t& out) const;
+};
+
+//Player and puzzle ratings, kept in memory over an append-only journal. Callers use the pack's puzzle indices, the
+//journal keys puzzles by their position so a pack that is reordered or grows keeps each history with its puzzle.
+//A puzzle without history starts from the difficulty its pack was graded with, else from its dm, longer mates rated
+//higher, or from the default.
+//The journal is rewritten on load once it holds twice as many records as there are ratings
+class RatingStore {
+    enum KIND : std::uint32_t {
+        Player,
+        Puzzle,
+        PuzzleKey
+    };
+
+    std::string path;
+    std::map<std::uint32_t, Rating> players;
+    std::vector<Rating> puzzles;
+    std::vector<std::uint32_t> keys;
+    std::map<std::uint32_t, std::uint32_t> byKey;
+    PuzzleIndex index;
+    FILE* journal;
+
+    void replay();
+    void compact();
+    void append(std::uint32_t kind, std::uint32_t id, const Rating& r);
+
+public:
+    RatingStore(const std::string& directory);
+    ~RatingStore();
+    RatingStore(const RatingStore&) = delete;
+    void operator=(const RatingStore&) = delete;
+
+    void load(const PuzzlePack& pack);
+
+    Rating player(std::uint32_t id) const;
+    Rating puzzle(std::uint32_t id) const;
+    void record(std::uint32_t player, std::uint32_t puzzle, bool solved, std::int64_t timestamp);
+    bool next(float target, const std::function<bool(std::uint32_t)>& skip, std::uint32_t& out) const;
+};
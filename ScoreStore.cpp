@@ -0,0 +1,289 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "ScoreStore.hpp"
+#include "FileSystem.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+namespace {
+    struct SnapshotHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t count;
+    };
+
+    const char MAGIC[4] = { 'B', 'M', 'S', 'S' };
+    const std::uint32_t VERSION = 1;
+}
+
+//FNV-1a over everything in front of the checksum, a torn write at the end of the journal fails it
+std::uint32_t ScoreStore::checksum(const ScoreRecord& record) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&record);
+    std::uint32_t hash = 2166136261u;
+
+    for (std::size_t i = 0; i < offsetof(ScoreRecord, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+ScoreStore::ScoreStore(const std::string& directory) :
+    snapshotPath(directory + "/scores.snapshot"),
+    journalPath(directory + "/scores.journal"),
+    journaled(0),
+    compacted(0),
+    busy(false),
+    unsaved(false),
+    stopping(false)
+{
+    FileSystem::makeDirectory(directory);
+    load();
+    writer = std::thread(&ScoreStore::write, this);
+}
+
+ScoreStore::~ScoreStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wake.notify_one();
+    writer.join();
+}
+
+void ScoreStore::index(const ScoreRecord& record) {
+    players.insert(std::make_pair(record.player, records.size()));
+    puzzles.insert(std::make_pair(record.puzzle, records.size()));
+    records.push_back(record);
+}
+
+//Runs once before the writer starts. The journal is replayed on top of the snapshot up to the first damaged record,
+//records a crash left behind after their snapshot are skipped by sequence, and anything replayed is folded straight away
+void ScoreStore::load() {
+    FILE* file = fopen(snapshotPath.c_str(), "rb");
+
+    if (file != nullptr) {
+        SnapshotHeader header;
+
+        if (fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION) {
+            ScoreRecord record;
+
+            for (std::uint64_t i = 0; i < header.count && fread(&record, sizeof(record), 1, file) == 1; i++)
+                if (record.checksum == checksum(record) && record.sequence == records.size())
+                    index(record);
+        }
+
+        fclose(file);
+    }
+
+    compacted = records.size();
+    file = fopen(journalPath.c_str(), "rb");
+
+    if (file == nullptr)
+        return;
+
+    ScoreRecord record;
+    bool replayed = false;
+
+    while (fread(&record, sizeof(record), 1, file) == 1 && record.checksum == checksum(record)) {
+        if (record.sequence != records.size())
+            continue;
+
+        index(record);
+        replayed = true;
+    }
+
+    fclose(file);
+    compacted = records.size();
+
+    if (replayed) {
+        std::vector<ScoreRecord> snapshot(records);
+        compact(snapshot);
+    }
+    else {
+        remove(journalPath.c_str());
+    }
+}
+
+//False when the old snapshot and journal are still the ones on disk
+bool ScoreStore::compact(std::vector<ScoreRecord>& snapshot) {
+    std::string temporary = snapshotPath + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+
+    if (file == nullptr)
+        return false;
+
+    SnapshotHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = snapshot.size();
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(snapshot.data(), sizeof(ScoreRecord), snapshot.size(), file) == snapshot.size();
+
+    FileSystem::sync(file);
+    written = fclose(file) == 0 && written;
+
+    if (!written || !FileSystem::replace(temporary, snapshotPath)) {
+        remove(temporary.c_str());
+        return false;
+    }
+
+    file = fopen(journalPath.c_str(), "wb");
+
+    if (file != nullptr)
+        fclose(file);
+
+    return true;
+}
+
+//The writer takes whatever queued up since its last pass and appends it in one write,
+//once the journal is due for compaction it writes a snapshot instead and starts the journal over.
+//A snapshot that fails leaves the journal as it was, so the batch is appended after all. Replay stops at the first
+//record missing from the journal, so after an append fails only a snapshot can save the records again
+void ScoreStore::write() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !pending.empty(); });
+
+        if (pending.empty() && !(stopping && unsaved))
+            break;
+
+        writing.swap(pending);
+        busy = true;
+
+        bool fold = unsaved || journaled + writing.size() >= std::max<std::size_t>(COMPACTION, compacted);
+        std::vector<ScoreRecord> snapshot;
+
+        if (fold)
+            snapshot = records;
+
+        lock.unlock();
+
+        bool folded = fold && compact(snapshot);
+        bool appended = false;
+
+        if (!folded && !unsaved) {
+            FILE* file = fopen(journalPath.c_str(), "ab");
+
+            if (file != nullptr) {
+                appended = fwrite(writing.data(), sizeof(ScoreRecord), writing.size(), file) == writing.size();
+                FileSystem::sync(file);
+                appended = fclose(file) == 0 && appended;
+            }
+        }
+
+        lock.lock();
+
+        if (folded) {
+            journaled = 0;
+            compacted = snapshot.size();
+            unsaved = false;
+        }
+        else if (appended) {
+            journaled += writing.size();
+        }
+        else {
+            unsaved = true;
+        }
+
+        writing.clear();
+        busy = false;
+        idle.notify_all();
+
+        //Shutting down, a snapshot that failed once is not tried over and over
+        if (stopping && pending.empty() && fold)
+            break;
+    }
+}
+
+//Called from the render thread, the record is readable at once and reaches the disk later
+void ScoreStore::submit(std::uint32_t player, std::uint32_t puzzle, float seconds, int score, std::int64_t timestamp) {
+    ScoreRecord record;
+    memset(&record, 0, sizeof(record));
+    record.player = player;
+    record.puzzle = puzzle;
+    record.seconds = seconds;
+    record.score = score;
+    record.timestamp = timestamp;
+
+    bool first;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        record.sequence = records.size();
+        record.checksum = checksum(record);
+        index(record);
+        first = pending.empty();
+        pending.push_back(record);
+    }
+
+    //Only the first record of a batch needs to wake the writer, the rest ride along
+    if (first)
+        wake.notify_one();
+}
+
+void ScoreStore::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending.empty() && !busy; });
+}
+
+std::vector<ScoreRecord> ScoreStore::byPlayer(std::uint32_t player) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<ScoreRecord> out;
+    auto range = players.equal_range(player);
+
+    for (auto it = range.first; it != range.second; ++it)
+        out.push_back(records[it->second]);
+
+    return out;
+}
+
+std::vector<ScoreRecord> ScoreStore::byPuzzle(std::uint32_t puzzle) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<ScoreRecord> out;
+    auto range = puzzles.equal_range(puzzle);
+
+    for (auto it = range.first; it != range.second; ++it)
+        out.push_back(records[it->second]);
+
+    return out;
+}
+
+std::vector<ScoreRecord> ScoreStore::all() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+//Highest score wins, a faster solve breaks the tie
+bool ScoreStore::best(std::uint32_t player, std::uint32_t puzzle, ScoreRecord& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = players.equal_range(player);
+    bool found = false;
+
+    for (auto it = range.first; it != range.second; ++it) {
+        const ScoreRecord& r = records[it->second];
+
+        if (r.puzzle != puzzle)
+            continue;
+
+        if (!found || r.score > out.score || (r.score == out.score && r.seconds < out.seconds))
+            out = r;
+
+        found = true;
+    }
+
+    return found;
+}
+
+std::size_t ScoreStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records.size();
+}
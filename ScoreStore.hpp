@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define COMPACTION 1024
+
+//One solved puzzle, written to disk exactly as laid out here
+struct ScoreRecord {
+    std::uint64_t sequence;
+    std::uint32_t player;
+    std::uint32_t puzzle;
+    float seconds;
+    std::int32_t score;
+    std::int64_t timestamp;
+    std::uint32_t checksum;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(ScoreRecord) == 40, "ScoreRecord is a file format");
+
+//Results live in memory with a snapshot plus an append-only journal behind them.
+//Submitting only queues the record, a writer thread batches the file writes and folds the journal into a new snapshot
+//once it holds COMPACTION records or as many as the snapshot, whichever is more, so compaction stays amortised O(1) per record.
+class ScoreStore {
+    std::string snapshotPath;
+    std::string journalPath;
+
+    std::vector<ScoreRecord> records;
+    std::multimap<std::uint32_t, std::size_t> players;
+    std::multimap<std::uint32_t, std::size_t> puzzles;
+
+    std::vector<ScoreRecord> pending;
+    std::vector<ScoreRecord> writing;
+    std::size_t journaled;
+    std::size_t compacted;
+    bool busy;
+    bool unsaved;
+    bool stopping;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::thread writer;
+
+    void load();
+    void index(const ScoreRecord& record);
+    void write();
+    bool compact(std::vector<ScoreRecord>& snapshot);
+
+public:
+    static std::uint32_t checksum(const ScoreRecord& record);
+
+    ScoreStore(const std::string& directory);
+    ~ScoreStore();
+    ScoreStore(const ScoreStore&) = delete;
+    void operator=(const ScoreStore&) = delete;
+
+    void submit(std::uint32_t player, std::uint32_t puzzle, float seconds, int score, std::int64_t timestamp);
+    void flush();
+
+    std::vector<ScoreRecord> byPlayer(std::uint32_t player) const;
+    std::vector<ScoreRecord> byPuzzle(std::uint32_t puzzle) const;
+    std::vector<ScoreRecord> all() const;
+    bool best(std::uint32_t player, std::uint32_t puzzle, ScoreRecord& out) const;
+    std::size_t size() const;
+};
@@ -0,0 +1,480 @@
+#include "Search.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace Chess {
+    const int VALUE[6] = { 100, 320, 330, 500, 900, 20000 };
+
+    namespace {
+        //Picks the best scored move left in the list and swaps it to the front of the unsearched part
+        Move next(MoveList& list, int* scores, int i) {
+            int best = i;
+
+            for (int j = i + 1; j < list.size; j++)
+                if (scores[j] > scores[best])
+                    best = j;
+
+            std::swap(list.moves[i], list.moves[best]);
+            std::swap(scores[i], scores[best]);
+            return list.moves[i];
+        }
+
+        int captured(const Position& position, Move m) {
+            if (flagOf(m) == EnPassant)
+                return VALUE[Pawn];
+
+            Piece victim = position.pieceOn(toOf(m));
+            return victim == NO_PIECE ? 0 : VALUE[typeOf(victim)];
+        }
+    }
+
+    //Material and piece squares from the side to move's point of view, blended from the middlegame scores to the
+    //endgame ones as pieces come off. The position keeps both sums up to date, so this only reads them
+    int evaluate(const Position& position) {
+        int phase = position.phase();
+        int score = (position.middlegame() * phase + position.endgame() * (PHASEMAX - phase)) / PHASEMAX;
+        return position.sideToMove() == White ? score : -score;
+    }
+
+    //Swap algorithm: both sides recapture on the target square with their least valuable piece, revealing x-rays as
+    //pieces come off, and either side may stop when going on would lose material
+    int see(const Position& position, Move m) {
+        if (flagOf(m) == Castle)
+            return 0;
+
+        Square from = fromOf(m);
+        Square to = toOf(m);
+        Color side = colorOf(position.pieceOn(from));
+        Bitboard occupancy = position.pieces() ^ bit(from);
+        Bitboard diagonal = position.pieces(WhiteBishop) | position.pieces(BlackBishop) | position.pieces(WhiteQueen) | position.pieces(BlackQueen);
+        Bitboard straight = position.pieces(WhiteRook) | position.pieces(BlackRook) | position.pieces(WhiteQueen) | position.pieces(BlackQueen);
+        PieceType attacker = typeOf(position.pieceOn(from));
+        int gain[32];
+        int d = 0;
+
+        gain[0] = captured(position, m);
+
+        if (flagOf(m) == EnPassant)
+            occupancy ^= bit(to - (side == White ? 8 : -8));
+
+        if (flagOf(m) == Promotion) {
+            attacker = promotionOf(m);
+            gain[0] += VALUE[attacker] - VALUE[Pawn];
+        }
+
+        Bitboard attackers = position.attackers(to, occupancy) & occupancy;
+
+        while (d < 31) {
+            side = (Color)(side ^ 1);
+            Bitboard mine = attackers & position.pieces(side);
+
+            if (!mine)
+                break;
+
+            d++;
+            gain[d] = VALUE[attacker] - gain[d - 1];
+
+            if (std::max(-gain[d - 1], gain[d]) < 0)
+                break;
+
+            Square s = NO_SQUARE;
+
+            for (int t = Pawn; t <= King && s == NO_SQUARE; t++) {
+                Bitboard b = mine & position.pieces(makePiece(side, (PieceType)t));
+
+                if (b) {
+                    s = lsb(b);
+                    attacker = (PieceType)t;
+                }
+            }
+
+            occupancy ^= bit(s);
+            attackers |= (bishopAttacks(to, occupancy) & diagonal) | (rookAttacks(to, occupancy) & straight);
+            attackers &= occupancy;
+        }
+
+        while (d > 0) {
+            gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+            d--;
+        }
+
+        return gain[0];
+    }
+
+    TranspositionTable::TranspositionTable(std::size_t megabytes) :
+        current(0)
+    {
+        resize(megabytes);
+    }
+
+    //The slot count is the largest power of two that fits, so a key finds its slot with a mask
+    void TranspositionTable::resize(std::size_t megabytes) {
+        std::size_t count = 1;
+
+        while (count * 2 * sizeof(TtEntry) <= std::max<std::size_t>(megabytes, 1) << 20)
+            count *= 2;
+
+        entries.assign(count, TtEntry());
+        clear();
+    }
+
+    void TranspositionTable::clear() {
+        TtEntry empty = { 0, NO_MOVE, 0, 0, BoundNone, 0 };
+        std::fill(entries.begin(), entries.end(), empty);
+        current = 0;
+    }
+
+    //Searches on several threads share a table without locks. The key is kept xor the rest of the entry, so an entry
+    //that two threads wrote at once no longer matches its position and reads as a miss
+    std::uint64_t TranspositionTable::check(const TtEntry& e) {
+        return (std::uint64_t)e.move | (std::uint64_t)(std::uint16_t)e.score << 16 | (std::uint64_t)(std::uint8_t)e.depth << 32 |
+            (std::uint64_t)e.bound << 40 | (std::uint64_t)e.generation << 48;
+    }
+
+    bool TranspositionTable::probe(std::uint64_t key, TtEntry& out) const {
+        TtEntry e = entries[key & (entries.size() - 1)];
+
+        if (e.bound == BoundNone || (e.key ^ check(e)) != key)
+            return false;
+
+        out = e;
+        out.key = key;
+        return true;
+    }
+
+    void TranspositionTable::store(std::uint64_t key, Move move, int score, int depth, Bound bound, int ply) {
+        TtEntry& slot = entries[key & (entries.size() - 1)];
+        TtEntry e = slot;
+        bool same = (e.key ^ check(e)) == key;
+
+        if (e.bound != BoundNone && !same && e.generation == current && e.depth > depth)
+            return;
+
+        //A result without a best move keeps the move an earlier search of the same position found
+        if (move == NO_MOVE && same)
+            move = e.move;
+
+        if (isMateDistance(score))
+            score += score > 0 ? ply : -ply;
+
+        e.move = move;
+        e.score = (std::int16_t)score;
+        e.depth = (std::int8_t)depth;
+        e.bound = bound;
+        e.generation = current;
+        e.key = key ^ check(e);
+        slot = e;
+    }
+
+    //Permille of a sample of slots filled by the current search, as UCI reports it
+    int TranspositionTable::hashfull() const {
+        std::size_t sample = std::min<std::size_t>(1000, entries.size());
+        int used = 0;
+
+        for (std::size_t i = 0; i < sample; i++)
+            used += entries[i].bound != BoundNone && entries[i].generation == current;
+
+        return (int)(used * 1000 / sample);
+    }
+
+    Search::Search() :
+        nodes(0), stopped(false), network(nullptr)
+    {}
+
+    void Search::make(Position& position, Move m, Undo& undo, int ply) {
+        position.make(m, undo);
+
+        if (network != nullptr)
+            network->update(accumulators[ply], position, accumulators[ply + 1]);
+    }
+
+    int Search::evaluate(const Position& position, int ply) const {
+        return network != nullptr ? network->evaluate(accumulators[ply], position.sideToMove()) : Chess::evaluate(position);
+    }
+
+    bool Search::expired() {
+        if ((limits.nodes != 0 && nodes >= limits.nodes) || (limits.stop != nullptr && *limits.stop))
+            stopped = true;
+
+        return stopped;
+    }
+
+    //Only positions since the last capture or pawn move can come back, and only with the same side to move
+    bool Search::repeated(const Position& position, int ply) const {
+        int reach = std::min(position.halfmoveClock(), ply + (int)limits.history.size());
+
+        for (int back = 4; back <= reach; back += 2) {
+            std::uint64_t earlier = back <= ply ? keys[ply - back] : limits.history[limits.history.size() - (back - ply)];
+
+            if (earlier == position.key())
+                return true;
+        }
+
+        return false;
+    }
+
+    //Previous best first, then winning and even captures by MVV-LVA, killers, quiet moves and finally losing captures
+    void Search::order(const Position& position, MoveList& list, int* scores, Move first, int ply) const {
+        for (int i = 0; i < list.size; i++) {
+            Move m = list.moves[i];
+            int victim = captured(position, m);
+
+            if (m == first)
+                scores[i] = 1 << 30;
+            else if (victim != 0 || flagOf(m) == Promotion)
+                scores[i] = (see(position, m) >= 0 ? 1 << 20 : -(1 << 20)) + victim * 8 - VALUE[typeOf(position.pieceOn(fromOf(m)))] / 100;
+            else if (ply < MAXPLY && (m == killers[ply][0] || m == killers[ply][1]))
+                scores[i] = 1 << 19;
+            else
+                scores[i] = 0;
+        }
+    }
+
+    int Search::quiesce(Position& position, int alpha, int beta, int ply) {
+        nodes++;
+        pvLength[ply] = ply;
+
+        if (expired())
+            return 0;
+
+        if (ply >= MAXPLY - 1)
+            return evaluate(position, ply);
+
+        bool check = position.inCheck();
+        MoveList list;
+        int stand = -INFINITY_SCORE;
+
+        //In check every evasion is searched and there is no standing pat
+        if (check) {
+            position.generate(list);
+
+            if (list.size == 0)
+                return -MATE + ply;
+        }
+        else {
+            stand = evaluate(position, ply);
+
+            if (stand >= beta)
+                return stand;
+
+            alpha = std::max(alpha, stand);
+            position.captures(list);
+        }
+
+        int scores[256];
+        order(position, list, scores, NO_MOVE, MAXPLY);
+        int best = stand;
+
+        for (int i = 0; i < list.size; i++) {
+            Move m = next(list, scores, i);
+
+            if (!check && flagOf(m) != Promotion) {
+                if (stand + captured(position, m) + DELTAMARGIN <= alpha)
+                    continue;
+
+                if (see(position, m) < 0)
+                    continue;
+            }
+
+            Undo undo;
+            make(position, m, undo, ply);
+            int score = -quiesce(position, -beta, -alpha, ply + 1);
+            position.unmake(m, undo);
+
+            if (stopped)
+                return 0;
+
+            if (score > best)
+                best = score;
+
+            if (score > alpha) {
+                alpha = score;
+                pv[ply][ply] = m;
+                memcpy(&pv[ply][ply + 1], &pv[ply + 1][ply + 1], (pvLength[ply + 1] - ply - 1) * sizeof(Move));
+                pvLength[ply] = pvLength[ply + 1];
+            }
+
+            if (alpha >= beta)
+                break;
+        }
+
+        return best;
+    }
+
+    //A position repeated below the root is a draw: a side that is worse can force the repetition again, and one
+    //that is better has to find something else. So is one where fifty moves passed without a capture or pawn move
+    int Search::alphaBeta(Position& position, int depth, int alpha, int beta, int ply) {
+        keys[ply] = position.key();
+
+        if (ply > 0 && (position.halfmoveClock() >= 100 || repeated(position, ply))) {
+            nodes++;
+            pvLength[ply] = ply;
+            return 0;
+        }
+
+        if (depth <= 0 || ply >= MAXPLY - 1) {
+            if (limits.quiescence)
+                return quiesce(position, alpha, beta, ply);
+
+            nodes++;
+            pvLength[ply] = ply;
+            return evaluate(position, ply);
+        }
+
+        nodes++;
+        pvLength[ply] = ply;
+
+        if (expired())
+            return 0;
+
+        TbResult stored;
+
+        if (limits.tablebases && ply > 0 && popcount(position.pieces()) <= Tablebases::instance().pieces() && Tablebases::instance().probe(position, stored))
+            return tbScore(stored, ply);
+
+        //The root always searches, its excluded moves are not part of what the table knows
+        TtEntry entry;
+        Move first = pv[ply][ply];
+        int alphaBefore = alpha;
+
+        if (limits.table != nullptr && limits.table->probe(position.key(), entry)) {
+            int score = isMateDistance(entry.score) ? entry.score - (entry.score > 0 ? ply : -ply) : entry.score;
+
+            if (ply > 0 && entry.depth >= depth && (entry.bound == BoundExact || (entry.bound == BoundLower && score >= beta) || (entry.bound == BoundUpper && score <= alpha)))
+                return score;
+
+            if (ply > 0 && entry.move != NO_MOVE)
+                first = entry.move;
+        }
+
+        MoveList list;
+        position.generate(list);
+
+        if (list.size == 0)
+            return position.inCheck() ? -MATE + ply : 0;
+
+        int scores[256];
+        order(position, list, scores, first, ply);
+        int best = -INFINITY_SCORE;
+        Move bestMove = NO_MOVE;
+
+        for (int i = 0; i < list.size; i++) {
+            Move m = next(list, scores, i);
+            bool quiet = position.pieceOn(toOf(m)) == NO_PIECE && flagOf(m) == Normal;
+
+            if (ply == 0 && std::find(excluded.begin(), excluded.end(), m) != excluded.end())
+                continue;
+
+            Undo undo;
+            make(position, m, undo, ply);
+            int score = -alphaBeta(position, depth - 1, -beta, -alpha, ply + 1);
+            position.unmake(m, undo);
+
+            if (stopped)
+                return 0;
+
+            if (score > best) {
+                best = score;
+                bestMove = m;
+            }
+
+            if (score > alpha) {
+                alpha = score;
+                pv[ply][ply] = m;
+                memcpy(&pv[ply][ply + 1], &pv[ply + 1][ply + 1], (pvLength[ply + 1] - ply - 1) * sizeof(Move));
+                pvLength[ply] = pvLength[ply + 1];
+            }
+
+            if (alpha >= beta) {
+                if (quiet && killers[ply][0] != m) {
+                    killers[ply][1] = killers[ply][0];
+                    killers[ply][0] = m;
+                }
+
+                break;
+            }
+        }
+
+        //A node that failed low has no move worth trying first next time
+        if (limits.table != nullptr && ply > 0)
+            limits.table->store(position.key(), best > alphaBefore ? bestMove : NO_MOVE, best, depth, best >= beta ? BoundLower : best > alphaBefore ? BoundExact : BoundUpper, ply);
+
+        return best;
+    }
+
+    //Each iteration starts from the last one's principal variation, an iteration cut short by the node limit is thrown away
+    SearchResult Search::run(Position position, const SearchLimits& searchLimits) {
+        SearchResult result;
+        result.best = NO_MOVE;
+        result.score = 0;
+        result.depth = 0;
+        result.nodes = 0;
+
+        limits = searchLimits;
+        nodes = 0;
+        stopped = false;
+        memset(pv, 0, sizeof(pv));
+        memset(pvLength, 0, sizeof(pvLength));
+        memset(killers, 0, sizeof(killers));
+
+        network = Network::instance().loaded() ? &Network::instance() : nullptr;
+
+        if (network != nullptr)
+            network->refresh(position, accumulators[0]);
+
+        MoveList legal;
+        position.generate(legal);
+        int count = std::max(1, std::min(limits.lines, legal.size));
+
+        for (int depth = 1; depth <= limits.depth && depth < MAXPLY; depth++) {
+            std::vector<SearchLine> lines;
+            excluded.clear();
+
+            for (int k = 0; k < count && !stopped; k++) {
+                //Every line starts from its own move of the last iteration
+                if (k < (int)result.lines.size()) {
+                    std::copy(result.lines[k].pv.begin(), result.lines[k].pv.end(), pv[0]);
+                    pvLength[0] = (int)result.lines[k].pv.size();
+                }
+
+                int score = alphaBeta(position, depth, -INFINITY_SCORE, INFINITY_SCORE, 0);
+
+                if (stopped || pvLength[0] == 0) {
+                    lines.push_back(SearchLine{ NO_MOVE, score, std::vector<Move>() });
+                    break;
+                }
+
+                lines.push_back(SearchLine{ pv[0][0], score, std::vector<Move>(pv[0], pv[0] + pvLength[0]) });
+                excluded.push_back(pv[0][0]);
+            }
+
+            if (stopped)
+                break;
+
+            std::stable_sort(lines.begin(), lines.end(), [](const SearchLine& a, const SearchLine& b) { return a.score > b.score; });
+
+            result.best = lines[0].move;
+            result.score = lines[0].score;
+            result.depth = depth;
+            result.nodes = nodes;
+            result.pv = lines[0].pv;
+            result.lines.clear();
+
+            for (const SearchLine& line : lines)
+                if (line.move != NO_MOVE)
+                    result.lines.push_back(line);
+
+            if (limits.iteration)
+                limits.iteration(result);
+
+            //A mate inside the nominal depth cannot get any shorter, one found by quiescence beyond it still can
+            if ((isMate(result.score) && MATE - std::abs(result.score) <= depth) || result.best == NO_MOVE)
+                break;
+        }
+
+        excluded.clear();
+        result.nodes = nodes;
+        return result;
+    }
+}
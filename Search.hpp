@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include "Chess.hpp"
+#include "Tablebase.hpp"
+#include "Nnue.hpp"
+
+#define MAXPLY 64
+#define MATE 32000
+#define INFINITY_SCORE 32001
+#define DELTAMARGIN 200
+#define HASHMB 16
+
+namespace Chess {
+    extern const int VALUE[6];
+
+    int evaluate(const Position& position);
+    int see(const Position& position, Move m);
+
+    inline bool isMate(int score) {
+        return score >= MATE - MAXPLY || score <= -MATE + MAXPLY;
+    }
+
+    //Tablebase mates keep their distance from the root, so a longer one can reach below the range isMate knows
+    inline int tbScore(const TbResult& result, int ply) {
+        return result.wdl > 0 ? MATE - ply - result.plies : result.wdl < 0 ? -MATE + ply + result.plies : 0;
+    }
+
+    //Mate and tablebase scores count from the root, the table keeps them counted from the position stored
+    inline bool isMateDistance(int score) {
+        return score >= MATE - 1024 || score <= -MATE + 1024;
+    }
+
+    enum Bound : std::uint8_t {
+        BoundNone,
+        BoundUpper,
+        BoundLower,
+        BoundExact
+    };
+
+    struct TtEntry {
+        std::uint64_t key;
+        Move move;
+        std::int16_t score;
+        std::int8_t depth;
+        std::uint8_t bound;
+        std::uint8_t generation;
+    };
+
+    //One entry per slot, replaced by a newer search or a deeper result. Searches that share a table over many positions
+    //start a new generation each time instead of clearing it, so old entries lose every replacement.
+    //Several threads may probe and store at once
+    class TranspositionTable {
+        std::vector<TtEntry> entries;
+        std::uint8_t current;
+
+        static std::uint64_t check(const TtEntry& e);
+
+    public:
+        TranspositionTable(std::size_t megabytes = HASHMB);
+
+        void resize(std::size_t megabytes);
+        void clear();
+        void age() { current++; }
+        bool probe(std::uint64_t key, TtEntry& out) const;
+        void store(std::uint64_t key, Move move, int score, int depth, Bound bound, int ply);
+        int hashfull() const;
+    };
+
+    struct SearchLine {
+        Move move;
+        int score;
+        std::vector<Move> pv;
+    };
+
+    //lines holds the best few root moves, best first, when more than one was asked for
+    struct SearchResult {
+        Move best;
+        int score;
+        int depth;
+        std::uint64_t nodes;
+        std::vector<Move> pv;
+        std::vector<SearchLine> lines;
+    };
+
+    //Without quiescence the horizon is a plain static evaluation, kept for comparison in the benchmarks like the
+    //tablebase probes, which end the search at any position below the root with few enough pieces.
+    //Another thread can end the search early through stop. Without a table nothing is remembered between nodes.
+    //history holds the keys of the game's positions before the root, oldest first, so repeating one counts as a draw
+    struct SearchLimits {
+        int depth;
+        std::uint64_t nodes;
+        int lines;
+        bool quiescence;
+        bool tablebases;
+        const std::atomic<bool>* stop;
+        TranspositionTable* table;
+        std::vector<std::uint64_t> history;
+        std::function<void(const SearchResult&)> iteration;
+
+        SearchLimits() :
+            depth(MAXPLY - 1), nodes(0), lines(1), quiescence(true), tablebases(true), stop(nullptr), table(nullptr)
+        {}
+    };
+
+    //Iterative deepening alpha-beta. At the horizon, quiescence search resolves captures and promotions so a hanging
+    //piece is not scored before the recapture: losing exchanges are cut by SEE and hopeless ones by delta pruning.
+    //Multi-PV searches the root once per line, each time leaving out the root moves of the lines already found.
+    //With a network loaded, every ply keeps an accumulator updated from its parent's on each move
+    class Search {
+        SearchLimits limits;
+        std::uint64_t nodes;
+        bool stopped;
+        Move pv[MAXPLY][MAXPLY];
+        int pvLength[MAXPLY];
+        Move killers[MAXPLY][2];
+        std::uint64_t keys[MAXPLY];
+        std::vector<Move> excluded;
+        const Network* network;
+        Accumulator accumulators[MAXPLY + 1];
+
+        bool expired();
+        bool repeated(const Position& position, int ply) const;
+        void make(Position& position, Move m, Undo& undo, int ply);
+        int evaluate(const Position& position, int ply) const;
+        void order(const Position& position, MoveList& list, int* scores, Move first, int ply) const;
+        int alphaBeta(Position& position, int depth, int alpha, int beta, int ply);
+        int quiesce(Position& position, int alpha, int beta, int ply);
+
+    public:
+        Search();
+
+        SearchResult run(Position position, const SearchLimits& searchLimits);
+    };
+}
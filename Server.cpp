@@ -0,0 +1,858 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <SFML/Network.hpp>
+#include "Protocol.hpp"
+#include "ScoreStore.hpp"
+#include "Puzzle.hpp"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#define EPOLL
+#endif
+
+#define SERVERPATH "./Leaderboard"
+#define PUZZLEPATH "./Assets/Puzzles/levels.epd"
+#define SELECTORSOCKETS 60
+#define READSIZE 16384
+
+std::atomic<unsigned long long> served(0);
+
+//Best result per player on each puzzle, kept ordered so a top N query walks the first N entries
+class Leaderboard {
+    struct Order {
+        bool operator()(const Protocol::Entry& a, const Protocol::Entry& b) const {
+            if (a.score != b.score)
+                return a.score > b.score;
+
+            if (a.seconds != b.seconds)
+                return a.seconds < b.seconds;
+
+            return a.player < b.player;
+        }
+    };
+
+    struct Ranking {
+        std::map<sf::Uint32, Protocol::Entry> best;
+        std::set<Protocol::Entry, Order> ranked;
+    };
+
+    ScoreStore store;
+    std::map<sf::Uint32, Ranking> rankings;
+    std::mutex mutex;
+
+    Protocol::Entry insert(sf::Uint32 player, sf::Uint32 puzzle, float seconds, sf::Int32 score);
+
+public:
+    Leaderboard(const std::string& directory);
+    Protocol::Entry record(sf::Uint32 player, sf::Uint32 puzzle, float seconds, sf::Int32 score);
+    void top(sf::Uint32 puzzle, std::size_t count, std::vector<Protocol::Entry>& out);
+};
+
+Leaderboard::Leaderboard(const std::string& directory) :
+    store(directory)
+{
+    std::vector<ScoreRecord> records = store.all();
+
+    for (std::size_t i = 0; i < records.size(); i++)
+        insert(records[i].player, records[i].puzzle, records[i].seconds, records[i].score);
+}
+
+Protocol::Entry Leaderboard::insert(sf::Uint32 player, sf::Uint32 puzzle, float seconds, sf::Int32 score) {
+    Ranking& ranking = rankings[puzzle];
+    Protocol::Entry entry = { player, score, seconds };
+    auto it = ranking.best.find(player);
+
+    if (it == ranking.best.end()) {
+        ranking.best[player] = entry;
+        ranking.ranked.insert(entry);
+        return entry;
+    }
+
+    if (!Order()(entry, it->second))
+        return it->second;
+
+    ranking.ranked.erase(it->second);
+    ranking.ranked.insert(entry);
+    it->second = entry;
+    return entry;
+}
+
+//Every submission is journaled, only a player's best one reaches the ranking
+Protocol::Entry Leaderboard::record(sf::Uint32 player, sf::Uint32 puzzle, float seconds, sf::Int32 score) {
+    std::lock_guard<std::mutex> lock(mutex);
+    store.submit(player, puzzle, seconds, score, (std::int64_t)time(NULL));
+    return insert(player, puzzle, seconds, score);
+}
+
+void Leaderboard::top(sf::Uint32 puzzle, std::size_t count, std::vector<Protocol::Entry>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.clear();
+    auto it = rankings.find(puzzle);
+
+    if (it == rankings.end())
+        return;
+
+    for (auto e = it->second.ranked.begin(); e != it->second.ranked.end() && out.size() < count; ++e)
+        out.push_back(*e);
+}
+
+struct Racer {
+    sf::Uint32 player;
+    sf::Uint16 slot;
+    sf::Uint16 solved;
+};
+
+struct Race {
+    std::vector<sf::Uint32> sequence;
+    std::vector<Racer> racers;
+    bool started;
+    int connected;
+    unsigned int version;
+    unsigned int built;
+    sf::Packet standings;
+};
+
+//What the server remembers about a connection between requests
+struct Session {
+    Race* race;
+    int racer;
+    sf::Uint32 joined;
+    bool started;
+    unsigned int seen;
+};
+
+//Racers fill the open race until it holds capacity of them, then it starts with one shuffled puzzle sequence for everyone.
+//The server is the authority on every answer, checked against the pack with the move generator
+class Races {
+    const PuzzlePack& pack;
+    std::size_t capacity;
+    std::size_t length;
+    std::vector<std::unique_ptr<Race>> races;
+    Race* open;
+    std::mutex mutex;
+
+public:
+    Races(const PuzzlePack& pack, std::size_t capacity, std::size_t length);
+    void join(Session& session, sf::Uint32 player, sf::Uint32 sequence);
+    void leave(Session& session);
+    bool answer(Session& session, sf::Uint16 slot, const std::string& move, bool& correct, sf::Uint16& solved);
+    bool start(Session& session, sf::Packet& out);
+    bool progress(Session& session, sf::Packet& out);
+};
+
+Races::Races(const PuzzlePack& pack, std::size_t capacity, std::size_t length) :
+    pack(pack),
+    capacity(std::max<std::size_t>(capacity, 1)),
+    length(length),
+    open(nullptr)
+{}
+
+void Races::join(Session& session, sf::Uint32 player, sf::Uint32 sequence) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (session.race != nullptr || pack.size() == 0)
+        return;
+
+    if (open == nullptr) {
+        races.push_back(std::unique_ptr<Race>(new Race));
+        open = races.back().get();
+        open->started = false;
+        open->connected = 0;
+        open->version = 1;
+        open->built = 0;
+
+        for (std::size_t i = 0; i < length; i++)
+            open->sequence.push_back((sf::Uint32)(rand() % pack.size()));
+    }
+
+    Racer racer = { player, 0, 0 };
+    session.race = open;
+    session.racer = (int)open->racers.size();
+    session.joined = sequence;
+    session.started = false;
+    session.seen = 0;
+    open->racers.push_back(racer);
+    open->connected++;
+
+    if (open->racers.size() >= capacity) {
+        open->started = true;
+        open = nullptr;
+    }
+}
+
+//A race is dropped once every racer has gone, racers in a race that never filled just leave a gap
+void Races::leave(Session& session) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (session.race == nullptr)
+        return;
+
+    Race* race = session.race;
+    session.race = nullptr;
+
+    if (--race->connected > 0)
+        return;
+
+    if (race == open)
+        open = nullptr;
+
+    for (std::size_t i = 0; i < races.size(); i++) {
+        if (races[i].get() == race) {
+            races[i].swap(races.back());
+            races.pop_back();
+            break;
+        }
+    }
+}
+
+//Each slot takes exactly one answer, right or wrong, so the client can move on without waiting for the verdict
+bool Races::answer(Session& session, sf::Uint16 slot, const std::string& move, bool& correct, sf::Uint16& solved) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Race* race = session.race;
+
+    if (race == nullptr || !race->started)
+        return false;
+
+    Racer& racer = race->racers[session.racer];
+
+    if (slot != racer.slot || slot >= race->sequence.size())
+        return false;
+
+    const Puzzle& puzzle = pack.puzzles[race->sequence[slot]];
+    Chess::Position position = puzzle.position;
+    correct = puzzle.accepts(position.parseUci(move));
+
+    racer.slot++;
+    racer.solved += correct ? 1 : 0;
+    solved = racer.solved;
+    race->version++;
+    return true;
+}
+
+bool Races::start(Session& session, sf::Packet& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Race* race = session.race;
+
+    if (race == nullptr || !race->started || session.started)
+        return false;
+
+    out.clear();
+    out << (sf::Uint8)Protocol::Start << session.joined << (sf::Uint16)race->sequence.size();
+
+    for (std::size_t i = 0; i < race->sequence.size(); i++)
+        out << race->sequence[i];
+
+    session.started = true;
+    return true;
+}
+
+//Standings are built once per change and shared by every racer's push
+bool Races::progress(Session& session, sf::Packet& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Race* race = session.race;
+
+    if (race == nullptr || !session.started || session.seen == race->version)
+        return false;
+
+    if (race->built != race->version) {
+        std::vector<Racer> leaders(race->racers);
+        std::size_t n = std::min<std::size_t>(RACELEADERS, leaders.size());
+
+        std::partial_sort(leaders.begin(), leaders.begin() + n, leaders.end(), [](const Racer& a, const Racer& b) {
+            return a.solved > b.solved || (a.solved == b.solved && a.slot < b.slot);
+        });
+
+        race->standings.clear();
+        race->standings << (sf::Uint8)Protocol::Progress << (sf::Uint16)race->racers.size() << (sf::Uint8)n;
+
+        for (std::size_t i = 0; i < n; i++)
+            race->standings << leaders[i].player << leaders[i].solved << leaders[i].slot;
+
+        race->built = race->version;
+    }
+
+    out = race->standings;
+    session.seen = race->version;
+    return true;
+}
+
+//Turns one request into at most one reply, shared by both backends. False means the client sent garbage and gets dropped
+class Handler {
+    Leaderboard& leaderboard;
+    Races& races;
+    std::vector<Protocol::Entry> leaders;
+
+public:
+    Handler(Leaderboard& leaderboard, Races& races);
+    bool respond(sf::Packet& request, sf::Packet& reply, Session& session);
+};
+
+Handler::Handler(Leaderboard& leaderboard, Races& races) :
+    leaderboard(leaderboard),
+    races(races)
+{}
+
+bool Handler::respond(sf::Packet& request, sf::Packet& reply, Session& session) {
+    sf::Uint8 op;
+    sf::Uint32 sequence;
+
+    reply.clear();
+
+    if (!(request >> op >> sequence))
+        return false;
+
+    if (op == Protocol::Submit) {
+        sf::Uint32 player, puzzle;
+        float seconds;
+        sf::Int32 score;
+
+        if (!(request >> player >> puzzle >> seconds >> score))
+            return false;
+
+        reply << (sf::Uint8)Protocol::Accepted << sequence << leaderboard.record(player, puzzle, seconds, score);
+    }
+    else if (op == Protocol::Top) {
+        sf::Uint32 puzzle;
+        sf::Uint8 count;
+
+        if (!(request >> puzzle >> count))
+            return false;
+
+        leaderboard.top(puzzle, std::min<std::size_t>(count, MAXLEADERS), leaders);
+        reply << (sf::Uint8)Protocol::Leaders << sequence << (sf::Uint8)leaders.size();
+
+        for (std::size_t i = 0; i < leaders.size(); i++)
+            reply << leaders[i];
+    }
+    else if (op == Protocol::Join) {
+        sf::Uint32 player;
+
+        if (!(request >> player))
+            return false;
+
+        races.join(session, player, sequence);
+    }
+    else if (op == Protocol::Answer) {
+        sf::Uint16 slot;
+        std::string move;
+        bool correct;
+        sf::Uint16 solved;
+
+        if (!(request >> slot >> move))
+            return false;
+
+        if (races.answer(session, slot, move, correct, solved))
+            reply << (sf::Uint8)Protocol::Verdict << sequence << slot << (sf::Uint8)correct << solved;
+        else
+            reply << (sf::Uint8)Protocol::Rejected << sequence;
+    }
+    else {
+        reply << (sf::Uint8)Protocol::Rejected << sequence;
+    }
+
+    served++;
+    return true;
+}
+
+#ifdef EPOLL
+//One thread, level triggered epoll over non-blocking sockets. Each connection buffers its own partial frames
+//and pending replies, and only asks for EPOLLOUT while a reply is stuck in the kernel's send buffer
+class EpollServer {
+    struct Connection {
+        std::vector<char> in;
+        std::vector<char> out;
+        std::size_t written;
+        bool waiting;
+        Session session;
+    };
+
+    Races& races;
+    Handler handler;
+    int listener;
+    int poller;
+    std::vector<Connection> connections;
+    sf::Packet request;
+    sf::Packet reply;
+    sf::Clock clock;
+
+    void accept();
+    void receive(int fd);
+    void flush(int fd);
+    void close(int fd);
+    void tick();
+
+public:
+    EpollServer(Leaderboard& leaderboard, Races& races, unsigned short port);
+    ~EpollServer();
+    bool listening() const;
+    void run();
+};
+
+EpollServer::EpollServer(Leaderboard& leaderboard, Races& races, unsigned short port) :
+    races(races),
+    handler(leaderboard, races),
+    listener(socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)),
+    poller(epoll_create1(0))
+{
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+        ::close(listener);
+        listener = -1;
+        return;
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event);
+}
+
+EpollServer::~EpollServer() {
+    for (std::size_t fd = 0; fd < connections.size(); fd++)
+        if (connections[fd].written != (std::size_t)-1)
+            ::close((int)fd);
+
+    if (listener >= 0)
+        ::close(listener);
+
+    ::close(poller);
+}
+
+bool EpollServer::listening() const {
+    return listener >= 0 && poller >= 0;
+}
+
+//Descriptors are small and reused, so connections are indexed by fd instead of looked up
+void EpollServer::accept() {
+    while (true) {
+        int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+
+        if (fd < 0)
+            return;
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        if ((std::size_t)fd >= connections.size()) {
+            Connection closed = { std::vector<char>(), std::vector<char>(), (std::size_t)-1, false, { nullptr, 0, 0, false, 0 } };
+            connections.resize(fd + 1, closed);
+        }
+
+        Connection& c = connections[fd];
+        Session session = { nullptr, 0, 0, false, 0 };
+        c.in.clear();
+        c.out.clear();
+        c.written = 0;
+        c.waiting = false;
+        c.session = session;
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void EpollServer::close(int fd) {
+    epoll_ctl(poller, EPOLL_CTL_DEL, fd, NULL);
+    ::close(fd);
+
+    Connection& c = connections[fd];
+    races.leave(c.session);
+    c.written = (std::size_t)-1;
+    std::vector<char>().swap(c.in);
+    std::vector<char>().swap(c.out);
+}
+
+//Drains the socket, answers every whole frame in arrival order and keeps the tail of a split frame for next time
+void EpollServer::receive(int fd) {
+    Connection& c = connections[fd];
+    char buffer[READSIZE];
+
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+
+        if (n > 0) {
+            c.in.insert(c.in.end(), buffer, buffer + n);
+            continue;
+        }
+
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            close(fd);
+            return;
+        }
+
+        break;
+    }
+
+    std::size_t offset = 0;
+    Protocol::UNFRAME result;
+
+    while ((result = Protocol::unframe(c.in, offset, request)) == Protocol::Complete) {
+        if (!handler.respond(request, reply, c.session)) {
+            close(fd);
+            return;
+        }
+
+        if (reply.getDataSize() > 0)
+            Protocol::frame(reply, c.out);
+    }
+
+    if (result == Protocol::Malformed) {
+        close(fd);
+        return;
+    }
+
+    c.in.erase(c.in.begin(), c.in.begin() + offset);
+    flush(fd);
+}
+
+void EpollServer::flush(int fd) {
+    Connection& c = connections[fd];
+
+    while (c.written < c.out.size()) {
+        ssize_t n = send(fd, &c.out[c.written], c.out.size() - c.written, MSG_NOSIGNAL);
+
+        if (n > 0) {
+            c.written += n;
+            continue;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            close(fd);
+            return;
+        }
+
+        if (!c.waiting) {
+            epoll_event event;
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.fd = fd;
+            epoll_ctl(poller, EPOLL_CTL_MOD, fd, &event);
+            c.waiting = true;
+        }
+
+        return;
+    }
+
+    c.out.clear();
+    c.written = 0;
+
+    if (c.waiting) {
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(poller, EPOLL_CTL_MOD, fd, &event);
+        c.waiting = false;
+    }
+}
+
+//Race pushes go out once per tick, whatever happened in between is folded into one Progress per racer
+void EpollServer::tick() {
+    for (std::size_t fd = 0; fd < connections.size(); fd++) {
+        Connection& c = connections[fd];
+
+        if (c.written == (std::size_t)-1 || c.session.race == nullptr)
+            continue;
+
+        if (races.start(c.session, reply))
+            Protocol::frame(reply, c.out);
+
+        if (races.progress(c.session, reply))
+            Protocol::frame(reply, c.out);
+
+        if (!c.out.empty())
+            flush((int)fd);
+    }
+}
+
+void EpollServer::run() {
+    epoll_event events[256];
+    float next = RACETICK;
+
+    while (true) {
+        int wait = (int)((next - clock.getElapsedTime().asSeconds()) * 1000.f);
+        int n = epoll_wait(poller, events, 256, std::max(wait, 0));
+
+        if (clock.getElapsedTime().asSeconds() >= next) {
+            tick();
+            next = clock.getElapsedTime().asSeconds() + RACETICK;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listener) {
+                accept();
+                continue;
+            }
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close(fd);
+                continue;
+            }
+
+            if (events[i].events & EPOLLOUT)
+                flush(fd);
+
+            if ((events[i].events & EPOLLIN) && connections[fd].written != (std::size_t)-1)
+                receive(fd);
+        }
+    }
+}
+#endif
+
+//Portable fallback on sf::SocketSelector. A selector is a select() set, which Windows caps at 64 sockets,
+//so clients are spread over shards of SELECTORSOCKETS, each with its own selector and thread
+class SelectorServer {
+    struct Shard {
+        std::mutex mutex;
+        std::vector<sf::TcpSocket*> incoming;
+        std::atomic<int> count;
+        std::thread thread;
+
+        Shard() :
+            count(0)
+        {}
+    };
+
+    Leaderboard& leaderboard;
+    Races& races;
+    sf::TcpListener listener;
+    std::vector<std::unique_ptr<Shard>> shards;
+    bool bound;
+
+    void serve(Shard& shard);
+
+public:
+    SelectorServer(Leaderboard& leaderboard, Races& races, unsigned short port);
+    bool listening() const;
+    void run();
+};
+
+SelectorServer::SelectorServer(Leaderboard& leaderboard, Races& races, unsigned short port) :
+    leaderboard(leaderboard),
+    races(races),
+    bound(listener.listen(port) == sf::Socket::Done)
+{}
+
+bool SelectorServer::listening() const {
+    return bound;
+}
+
+//Replies are small, a full send buffer is waited out rather than queued
+void send(sf::TcpSocket& socket, sf::Packet& packet) {
+    sf::Socket::Status sent;
+
+    while ((sent = socket.send(packet)) == sf::Socket::Partial || sent == sf::Socket::NotReady)
+        std::this_thread::yield();
+}
+
+void SelectorServer::serve(Shard& shard) {
+    Handler handler(leaderboard, races);
+    sf::SocketSelector selector;
+    std::vector<sf::TcpSocket*> sockets;
+    std::vector<Session> sessions;
+    sf::Packet request;
+    sf::Packet reply;
+    sf::Clock clock;
+    float next = RACETICK;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            for (std::size_t i = 0; i < shard.incoming.size(); i++) {
+                Session session = { nullptr, 0, 0, false, 0 };
+                shard.incoming[i]->setBlocking(false);
+                selector.add(*shard.incoming[i]);
+                sockets.push_back(shard.incoming[i]);
+                sessions.push_back(session);
+            }
+
+            shard.incoming.clear();
+        }
+
+        bool ready = selector.wait(sf::milliseconds(10));
+        bool tick = clock.getElapsedTime().asSeconds() >= next;
+
+        if (tick)
+            next = clock.getElapsedTime().asSeconds() + RACETICK;
+
+        for (std::size_t i = 0; i < sockets.size();) {
+            sf::TcpSocket* socket = sockets[i];
+            sf::Socket::Status status = sf::Socket::NotReady;
+
+            if (ready && selector.isReady(*socket)) {
+                while ((status = socket->receive(request)) == sf::Socket::Done) {
+                    if (!handler.respond(request, reply, sessions[i])) {
+                        status = sf::Socket::Error;
+                        break;
+                    }
+
+                    if (reply.getDataSize() > 0)
+                        send(*socket, reply);
+                }
+            }
+
+            if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+                races.leave(sessions[i]);
+                selector.remove(*socket);
+                delete socket;
+                sockets[i] = sockets.back();
+                sockets.pop_back();
+                sessions[i] = sessions.back();
+                sessions.pop_back();
+                shard.count--;
+                continue;
+            }
+
+            if (tick && races.start(sessions[i], reply))
+                send(*socket, reply);
+
+            if (tick && races.progress(sessions[i], reply))
+                send(*socket, reply);
+
+            i++;
+        }
+    }
+}
+
+void SelectorServer::run() {
+    while (true) {
+        sf::TcpSocket* socket = new sf::TcpSocket;
+
+        if (listener.accept(*socket) != sf::Socket::Done) {
+            delete socket;
+            continue;
+        }
+
+        Shard* shard = nullptr;
+
+        for (std::size_t i = 0; i < shards.size() && shard == nullptr; i++)
+            if (shards[i]->count < SELECTORSOCKETS)
+                shard = shards[i].get();
+
+        if (shard == nullptr) {
+            shards.push_back(std::unique_ptr<Shard>(new Shard));
+            shard = shards.back().get();
+            shard->thread = std::thread(&SelectorServer::serve, this, std::ref(*shard));
+        }
+
+        shard->count++;
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->incoming.push_back(socket);
+    }
+}
+
+//Thousands of clients need thousands of descriptors, more than the default soft limit on Linux
+void raiseDescriptorLimit() {
+#ifdef __linux__
+    rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+void report() {
+    unsigned long long last = 0;
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        unsigned long long now = served;
+
+        if (now != last)
+            printf("%llu requests/s\n", now - last);
+
+        last = now;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned short port = SERVERPORT;
+    bool selector = false;
+    int racers = 2;
+    int length = 20;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            port = (unsigned short)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--racers") == 0 && i + 1 < argc)
+            racers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc)
+            length = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--selector") == 0)
+            selector = true;
+    }
+
+    raiseDescriptorLimit();
+    srand((unsigned int)time(NULL));
+
+    PuzzlePack pack;
+
+    if (!pack.load(PUZZLEPATH))
+        printf("Could not load %s, races are disabled\n", PUZZLEPATH);
+
+    Leaderboard leaderboard(SERVERPATH);
+    Races races(pack, racers, length);
+    std::thread(report).detach();
+
+#ifdef EPOLL
+    if (!selector) {
+        EpollServer server(leaderboard, races, port);
+
+        if (!server.listening()) {
+            printf("Could not listen on port %u\n", port);
+            return 1;
+        }
+
+        printf("Leaderboard server on port %u (epoll)\n", port);
+        server.run();
+        return 0;
+    }
+#endif
+
+    SelectorServer server(leaderboard, races, port);
+
+    if (!server.listening()) {
+        printf("Could not listen on port %u\n", port);
+        return 1;
+    }
+
+    printf("Leaderboard server on port %u (selector)\n", port);
+    server.run();
+    return 0;
+}
@@ -1,19 +1,106 @@
 #include <vector>
 #include <string>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <fstream>
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
+#include "Chess.hpp"
+#include "ScoreStore.hpp"
+#include "Puzzle.hpp"
+#include "Search.hpp"
+#include "Nnue.hpp"
+#include "Mate.hpp"
+#include "Tablebase.hpp"
+#include "Hints.hpp"
+#include "Rating.hpp"
+#include "Feed.hpp"
+#include "Protocol.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#endif
 
 #define GAMELENGTH 30.f
+#define FONTPATH "./Assets/Fonts/FredokaOne-Regular.ttf"
+#define MUSICPATH "./Assets/Audio/the-final-game.ogg"
+#define MUSICBUFFER 0.5f
+#define VOICES 8
+#define MOVETIME 0.25f
+#define REPLYDELAY 0.35f
+#define PARTICLES 50000
+#define SAVEPATH "./Saves"
+#define PUZZLEPATH "./Assets/Puzzles/levels.epd"
+#define TACTICSPATH "./Assets/Puzzles/tactics.epd"
+#define TACTICSDEPTH 6
+#define MATESPATH "./Assets/Puzzles/mates.epd"
+#define PLAYER 0
 
 int score = 0;
 
+#ifdef _DEBUG
+//Debug builds count every heap allocation so hot paths can be checked to stay allocation free
+namespace Diagnostics {
+    std::atomic<unsigned long long> allocations(0);
+    unsigned long long frameAllocations = 0;
+    unsigned long long hudAllocations = 0;
+    int frames = 0;
+
+    void report(unsigned long long allocated, unsigned long long hud) {
+        frameAllocations += allocated;
+        hudAllocations += hud;
+
+        if (++frames < 600)
+            return;
+
+        printf("%d frames: %llu allocations, %llu from HUD text updates\n", frames, frameAllocations, hudAllocations);
+        frames = 0;
+        frameAllocations = 0;
+        hudAllocations = 0;
+    }
+}
+
+void* operator new(std::size_t size) {
+    Diagnostics::allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+#endif
+
+//Batched math picks SSE2 or NEON when the target has it, define UTILITIES_SCALAR to force the plain loops
+#if !defined(UTILITIES_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define UTILITIES_SSE
+#include <emmintrin.h>
+#elif !defined(UTILITIES_SCALAR) && (defined(__aarch64__) || defined(_M_ARM64))
+#define UTILITIES_NEON
+#include <arm_neon.h>
+#endif
+
 namespace Utilities {
+    static_assert(sizeof(sf::Vector2f) == 2 * sizeof(float), "batched math reads sf::Vector2f arrays as packed floats");
+
     sf::Vector2f linearInterpolate(sf::Vector2f a, sf::Vector2f b, float t) {
-        return sf::Vector2f(a + sf::Vector2f(t * (b - a).x, t * (b - a).y));
+        return sf::Vector2f(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y));
     }
 
     sf::Vector2f Normalize(sf::Vector2f v) {
-        float l = std::sqrt(std::pow(v.x, 2) + std::pow(v.y, 2));
+        float l = std::sqrt(v.x * v.x + v.y * v.y);
 
         return l == 0 ? sf::Vector2f() : sf::Vector2f(
             v.x /
@@ -23,7 +110,10 @@ namespace Utilities {
     }
 
     float distanceBetween(sf::Vector2f a, sf::Vector2f b) {
-        return sqrt(pow(b.x - a.x, 2) + pow(b.y - a.y, 2) * 1.f);
+        float x = b.x - a.x;
+        float y = b.y - a.y;
+
+        return std::sqrt(x * x + y * y);
     }
 
     float radiansToDegrees(float f) {
@@ -34,353 +124,1233 @@ namespace Utilities {
         return f * (3.141592653589793238463f / 180.0f);
     }
 
+    //out[i] = Normalize(in[i]), zero vectors stay zero
+    void normalize(const sf::Vector2f* in, sf::Vector2f* out, std::size_t n) {
+        const float* src = &in->x;
+        float* dst = &out->x;
+        std::size_t i = 0;
+
+#if defined(UTILITIES_SSE)
+        for (; i + 2 <= n; i += 2) {
+            __m128 v = _mm_loadu_ps(src + 2 * i);
+            __m128 sq = _mm_mul_ps(v, v);
+            __m128 length = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+            __m128 nonzero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+            _mm_storeu_ps(dst + 2 * i, _mm_and_ps(nonzero, _mm_div_ps(v, _mm_sqrt_ps(length))));
+        }
+#elif defined(UTILITIES_NEON)
+        for (; i + 2 <= n; i += 2) {
+            float32x4_t v = vld1q_f32(src + 2 * i);
+            float32x4_t sq = vmulq_f32(v, v);
+            float32x4_t length = vaddq_f32(sq, vrev64q_f32(sq));
+            uint32x4_t nonzero = vcgtq_f32(length, vdupq_n_f32(0.f));
+            float32x4_t unit = vdivq_f32(v, vsqrtq_f32(length));
+            vst1q_f32(dst + 2 * i, vreinterpretq_f32_u32(vandq_u32(nonzero, vreinterpretq_u32_f32(unit))));
+        }
+#endif
+
+        for (; i < n; i++)
+            out[i] = Normalize(in[i]);
+    }
+
+    //out[i] = distanceBetween(a[i], b[i])
+    void distance(const sf::Vector2f* a, const sf::Vector2f* b, float* out, std::size_t n) {
+        const float* pa = &a->x;
+        const float* pb = &b->x;
+        std::size_t i = 0;
+
+#if defined(UTILITIES_SSE)
+        for (; i + 4 <= n; i += 4) {
+            __m128 d0 = _mm_sub_ps(_mm_loadu_ps(pb + 2 * i), _mm_loadu_ps(pa + 2 * i));
+            __m128 d1 = _mm_sub_ps(_mm_loadu_ps(pb + 2 * i + 4), _mm_loadu_ps(pa + 2 * i + 4));
+            d0 = _mm_mul_ps(d0, d0);
+            d1 = _mm_mul_ps(d1, d1);
+            __m128 x = _mm_shuffle_ps(d0, d1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 y = _mm_shuffle_ps(d0, d1, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(x, y)));
+        }
+#elif defined(UTILITIES_NEON)
+        for (; i + 4 <= n; i += 4) {
+            float32x4x2_t va = vld2q_f32(pa + 2 * i);
+            float32x4x2_t vb = vld2q_f32(pb + 2 * i);
+            float32x4_t x = vsubq_f32(vb.val[0], va.val[0]);
+            float32x4_t y = vsubq_f32(vb.val[1], va.val[1]);
+            vst1q_f32(out + i, vsqrtq_f32(vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y))));
+        }
+#endif
+
+        for (; i < n; i++)
+            out[i] = distanceBetween(a[i], b[i]);
+    }
+
+    //out[i] = linearInterpolate(a[i], b[i], t), a plain float loop the compiler vectorizes on its own
+    void lerp(const sf::Vector2f* a, const sf::Vector2f* b, float t, sf::Vector2f* out, std::size_t n) {
+        const float* pa = &a->x;
+        const float* pb = &b->x;
+        float* dst = &out->x;
+
+        for (std::size_t i = 0; i < 2 * n; i++)
+            dst[i] = pa[i] + t * (pb[i] - pa[i]);
+    }
+
+    //out[i] = linearInterpolate(a[i], b[i], t[i])
+    void lerp(const sf::Vector2f* a, const sf::Vector2f* b, const float* t, sf::Vector2f* out, std::size_t n) {
+        const float* pa = &a->x;
+        const float* pb = &b->x;
+        float* dst = &out->x;
+        std::size_t i = 0;
+
+#if defined(UTILITIES_SSE)
+        for (; i + 4 <= n; i += 4) {
+            __m128 vt = _mm_loadu_ps(t + i);
+            __m128 a0 = _mm_loadu_ps(pa + 2 * i);
+            __m128 a1 = _mm_loadu_ps(pa + 2 * i + 4);
+            __m128 t0 = _mm_unpacklo_ps(vt, vt);
+            __m128 t1 = _mm_unpackhi_ps(vt, vt);
+            _mm_storeu_ps(dst + 2 * i, _mm_add_ps(a0, _mm_mul_ps(t0, _mm_sub_ps(_mm_loadu_ps(pb + 2 * i), a0))));
+            _mm_storeu_ps(dst + 2 * i + 4, _mm_add_ps(a1, _mm_mul_ps(t1, _mm_sub_ps(_mm_loadu_ps(pb + 2 * i + 4), a1))));
+        }
+#elif defined(UTILITIES_NEON)
+        for (; i + 4 <= n; i += 4) {
+            float32x4x2_t va = vld2q_f32(pa + 2 * i);
+            float32x4x2_t vb = vld2q_f32(pb + 2 * i);
+            float32x4_t vt = vld1q_f32(t + i);
+            float32x4x2_t result;
+            result.val[0] = vmlaq_f32(va.val[0], vt, vsubq_f32(vb.val[0], va.val[0]));
+            result.val[1] = vmlaq_f32(va.val[1], vt, vsubq_f32(vb.val[1], va.val[1]));
+            vst2q_f32(dst + 2 * i, result);
+        }
+#endif
+
+        for (; i < n; i++)
+            out[i] = linearInterpolate(a[i], b[i], t[i]);
+    }
+
+    //p[i] += v[i] * dt over plain float arrays, the integration step for structure-of-arrays data
+    void integrate(float* p, const float* v, float dt, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++)
+            p[i] += v[i] * dt;
+    }
 }
 
-//Engine is a singleton
-class Engine {
-    static Engine* engine;
+typedef unsigned int Entity;
+
+//Layers are drawn back to front, everything inside one layer keeps no particular order
+enum LAYER {
+    LayerBackground,
+    LayerBoard,
+    LayerHighlight,
+    LayerPieces,
+    LayerDrag,
+    LayerEffects,
+    LayerHud,
+    LayerCursor,
+    LayerCount
+};
 
-    sf::VideoMode video;
-    sf::Clock clock;
+//RenderQueue collects a frame of draw commands under a sort key and submits them with as few state changes as it can
+class RenderQueue {
+    struct Command {
+        sf::Uint64 key;
+        const sf::Drawable* drawable;
+        sf::RenderStates states;
+        unsigned int vertex;
+    };
 
-    Engine();
+    std::vector<Command> commands;
+    std::vector<sf::Vertex> quads;
+    std::vector<sf::Vertex> batch;
+    std::vector<const void*> ids;
 
-public:
-    sf::RenderWindow window;
-    sf::View view;
-    sf::Event event;
+    unsigned int id(const void* p);
+    sf::Uint64 key(int layer, bool drawable, const sf::RenderStates& states);
 
-    float deltaTime;
+public:
+    unsigned int drawCalls;
 
-    Engine(Engine& other) = delete;
-    void operator=(const Engine&) = delete;
-    static Engine& instance();
-    void render(sf::Sprite& sprite);
-    void render(sf::Text& text);
-    void render(sf::Vertex* v, int l);
-    sf::Event& next();
-    sf::Vector2f getMousePosition();
+    RenderQueue();
+    void sprite(int layer, const sf::Texture* texture, const sf::Vertex* quad);
+    void drawable(int layer, const sf::Drawable& drawable, const sf::RenderStates& states);
+    void submit(sf::RenderTarget& target);
 };
 
-Engine::Engine():
-    video(1920, 1080),
-    window(this->video, "Best Move"),
-    view(sf::FloatRect(0, 0, 1920, 1080)),
-    deltaTime(0.f)
-{
-    srand(time(NULL));
-    window.setView(view);
-    window.setMouseCursorVisible(false);
-    window.setKeyRepeatEnabled(false);
-}
+RenderQueue::RenderQueue() :
+    drawCalls(0)
+{}
 
-Engine& Engine::instance() {
-    static Engine* engine = new Engine();
-    return *engine;
+//Textures and shaders get small ids in order of first use, a frame only ever sees a handful of them
+unsigned int RenderQueue::id(const void* p) {
+    if (p == nullptr)
+        return 0;
+
+    for (std::size_t i = 0; i < ids.size(); i++)
+        if (ids[i] == p)
+            return (unsigned int)i + 1;
+
+    ids.push_back(p);
+    return (unsigned int)ids.size();
 }
 
-void Engine::render(sf::Sprite& sprite)
-{
-    window.draw(sprite);
+//Layer in the top byte, then sprites before other drawables, then shader, then texture
+sf::Uint64 RenderQueue::key(int layer, bool drawable, const sf::RenderStates& states) {
+    return ((sf::Uint64)layer << 56) | ((sf::Uint64)drawable << 55) |
+        ((sf::Uint64)(id(states.shader) & 0x7fff) << 40) | ((sf::Uint64)(id(states.texture) & 0xffffff) << 16);
 }
 
-void Engine::render(sf::Text& text)
-{
-    window.draw(text);
+void RenderQueue::sprite(int layer, const sf::Texture* texture, const sf::Vertex* quad) {
+    Command c = { 0, nullptr, sf::RenderStates(texture), (unsigned int)quads.size() };
+    c.key = key(layer, false, c.states);
+    commands.push_back(c);
+    quads.insert(quads.end(), quad, quad + 4);
 }
 
-sf::Event& Engine::next()
-{
-    deltaTime = clock.restart().asSeconds();
-    window.pollEvent(event);
-    window.clear();
-    
-    return event;
+void RenderQueue::drawable(int layer, const sf::Drawable& drawable, const sf::RenderStates& states) {
+    Command c = { 0, &drawable, states, 0 };
+    c.key = key(layer, true, states);
+    commands.push_back(c);
 }
 
-sf::Vector2f Engine::getMousePosition() {
-    return window.mapPixelToCoords(sf::Mouse::getPosition(window));
+//Sorting is stable so equal keys keep submission order, consecutive sprites sharing a key become one draw call
+void RenderQueue::submit(sf::RenderTarget& target) {
+    std::stable_sort(commands.begin(), commands.end(), [](const Command& a, const Command& b) {
+        return a.key < b.key;
+    });
+
+    drawCalls = 0;
+
+    for (std::size_t i = 0; i < commands.size();) {
+        const Command& c = commands[i];
+
+        if (c.drawable != nullptr) {
+            target.draw(*c.drawable, c.states);
+            drawCalls++;
+            i++;
+            continue;
+        }
+
+        batch.clear();
+
+        for (; i < commands.size() && commands[i].drawable == nullptr && commands[i].key == c.key; i++)
+            batch.insert(batch.end(), quads.begin() + commands[i].vertex, quads.begin() + commands[i].vertex + 4);
+
+        target.draw(batch.data(), batch.size(), sf::Quads, c.states);
+        drawCalls++;
+    }
+
+    commands.clear();
+    quads.clear();
+    ids.clear();
 }
 
-class Actor {
-protected:
-    Actor();
-    virtual ~Actor() {};
+//World keeps every sprite entity in parallel component arrays and runs its systems as linear passes over them
+class World {
+public:
+    enum BEHAVIOR {
+        Static,
+        Drift,
+        FollowMouse
+    };
 
-    Engine& engine;
+    static const unsigned int ALWAYS = 0xffffffff;
+
+private:
+    std::vector<unsigned int> slots;
+    std::vector<Entity> released;
+
+    std::vector<Entity> entities;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<float> scaleX;
+    std::vector<float> scaleY;
+    std::vector<const sf::Texture*> textures;
+    std::vector<sf::FloatRect> rects;
+    std::vector<unsigned char> layers;
+    std::vector<unsigned char> behaviors;
+    std::vector<unsigned int> shown;
+
+    unsigned int frame;
 
 public:
-    virtual bool pass() = 0;
-    virtual void execute() = 0;
+    World();
+    Entity create(int layer);
+    void destroy(Entity e);
+    void setTexture(Entity e, const sf::Texture* texture, sf::IntRect rect);
+    void setPosition(Entity e, sf::Vector2f p);
+    sf::Vector2f getPosition(Entity e) const;
+    void setVelocity(Entity e, sf::Vector2f v);
+    void setScale(Entity e, sf::Vector2f s);
+    sf::Vector2f getScale(Entity e) const;
+    sf::Vector2f getSize(Entity e) const;
+    void setLayer(Entity e, int layer);
+    void setBehavior(Entity e, BEHAVIOR b);
+    void show(Entity e, bool always = false);
+    void update(float dt, sf::Vector2f mouse);
+    void render(RenderQueue& queue);
+    std::size_t size() const;
 };
 
-Actor::Actor() :
-    engine(Engine::instance())
+World::World() :
+    frame(0)
 {}
 
-class ActorSprite : public Actor {
-protected:
-    sf::Texture texture;
-    sf::Sprite sprite;
-
-    ActorSprite(std::string fp);
-    ActorSprite(std::string fp, int x, int y, int w, int h);
-    ActorSprite(std::string fp, sf::IntRect ir);
-    virtual ~ActorSprite();
-    void draw();
-    virtual bool pass() override;
-};
+Entity World::create(int layer) {
+    Entity e;
 
-ActorSprite::ActorSprite(std::string fp) {
-    if (texture.loadFromFile(fp))
-    {
-        sprite.setTexture(texture);
+    if (!released.empty()) {
+        e = released.back();
+        released.pop_back();
     }
+    else {
+        e = (Entity)slots.size();
+        slots.push_back(0);
+    }
+
+    slots[e] = (unsigned int)entities.size();
+    entities.push_back(e);
+    x.push_back(0.f);
+    y.push_back(0.f);
+    vx.push_back(0.f);
+    vy.push_back(0.f);
+    scaleX.push_back(1.f);
+    scaleY.push_back(1.f);
+    textures.push_back(nullptr);
+    rects.push_back(sf::FloatRect());
+    layers.push_back((unsigned char)layer);
+    behaviors.push_back(Static);
+    shown.push_back(frame - 1);
+
+    return e;
 }
 
-ActorSprite::ActorSprite(std::string fp, int x, int y, int w, int h) {
-    if (texture.loadFromFile(fp, sf::IntRect(x, y, w, h)))
-    {
-        sprite.setTexture(texture);
-    }
+//The last entity moves into the freed slot so every component array stays dense
+void World::destroy(Entity e) {
+    unsigned int i = slots[e];
+    unsigned int last = (unsigned int)entities.size() - 1;
+
+    entities[i] = entities[last];
+    x[i] = x[last];
+    y[i] = y[last];
+    vx[i] = vx[last];
+    vy[i] = vy[last];
+    scaleX[i] = scaleX[last];
+    scaleY[i] = scaleY[last];
+    textures[i] = textures[last];
+    rects[i] = rects[last];
+    layers[i] = layers[last];
+    behaviors[i] = behaviors[last];
+    shown[i] = shown[last];
+    slots[entities[i]] = i;
+
+    entities.pop_back();
+    x.pop_back();
+    y.pop_back();
+    vx.pop_back();
+    vy.pop_back();
+    scaleX.pop_back();
+    scaleY.pop_back();
+    textures.pop_back();
+    rects.pop_back();
+    layers.pop_back();
+    behaviors.pop_back();
+    shown.pop_back();
+
+    released.push_back(e);
 }
 
-ActorSprite::ActorSprite(std::string fp, sf::IntRect ir) {
-    if (texture.loadFromFile(fp, ir))
-    {
-        sprite.setTexture(texture);
-    }
+void World::setTexture(Entity e, const sf::Texture* texture, sf::IntRect rect) {
+    unsigned int i = slots[e];
+
+    if (rect.width == 0 || rect.height == 0)
+        rect = sf::IntRect(0, 0, (int)texture->getSize().x, (int)texture->getSize().y);
+
+    textures[i] = texture;
+    rects[i] = sf::FloatRect(rect);
 }
 
-ActorSprite::~ActorSprite() {}
+void World::setPosition(Entity e, sf::Vector2f p) {
+    x[slots[e]] = p.x;
+    y[slots[e]] = p.y;
+}
 
-void ActorSprite::draw() {
-    engine.render(sprite);
+sf::Vector2f World::getPosition(Entity e) const {
+    return sf::Vector2f(x[slots[e]], y[slots[e]]);
 }
 
-bool ActorSprite::pass() {
-    return true;
+void World::setVelocity(Entity e, sf::Vector2f v) {
+    vx[slots[e]] = v.x;
+    vy[slots[e]] = v.y;
 }
 
-class ActorText : public Actor {
-protected:
-    sf::Font font;
-    sf::Text text;
+void World::setScale(Entity e, sf::Vector2f s) {
+    scaleX[slots[e]] = s.x;
+    scaleY[slots[e]] = s.y;
+}
 
-    ActorText(std::string fp);
-    ActorText(std::string fp, std::string s);
-    virtual ~ActorText();
-    void draw();
-    virtual bool pass() override;
-};
+sf::Vector2f World::getScale(Entity e) const {
+    return sf::Vector2f(scaleX[slots[e]], scaleY[slots[e]]);
+}
 
-void ActorText::draw() {
-    engine.render(text);
+sf::Vector2f World::getSize(Entity e) const {
+    return sf::Vector2f(rects[slots[e]].width, rects[slots[e]].height);
 }
 
-ActorText::~ActorText() {}
+void World::setLayer(Entity e, int layer) {
+    layers[slots[e]] = (unsigned char)layer;
+}
 
-ActorText::ActorText(std::string fp) {
-    if (font.loadFromFile(fp))
-    {
-        text.setFont(font);
+void World::setBehavior(Entity e, BEHAVIOR b) {
+    behaviors[slots[e]] = (unsigned char)b;
+}
+
+//Entities are drawn on the frames they are shown, or on every frame once shown with always set
+void World::show(Entity e, bool always) {
+    shown[slots[e]] = always ? ALWAYS : frame;
+}
+
+void World::update(float dt, sf::Vector2f mouse) {
+    std::size_t n = entities.size();
+
+    if (n == 0)
+        return;
+
+    Utilities::integrate(x.data(), vx.data(), dt, n);
+    Utilities::integrate(y.data(), vy.data(), dt, n);
+
+    for (std::size_t i = 0; i < n; i++) {
+        if (behaviors[i] == FollowMouse) {
+            x[i] = mouse.x;
+            y[i] = mouse.y;
+        }
     }
 }
 
-ActorText::ActorText(std::string fp, std::string s) {
-    if (font.loadFromFile(fp))
-    {
-        text.setFont(font);
+//Queues a quad for every entity shown this frame, ordering and batching is left to the queue
+void World::render(RenderQueue& queue) {
+    std::size_t n = entities.size();
+
+    for (std::size_t i = 0; i < n; i++) {
+        if (shown[i] != frame && shown[i] != ALWAYS)
+            continue;
+
+        const sf::FloatRect& r = rects[i];
+        float w = r.width * scaleX[i];
+        float h = r.height * scaleY[i];
+        sf::Vertex quad[4] = {
+            sf::Vertex(sf::Vector2f(x[i], y[i]), sf::Vector2f(r.left, r.top)),
+            sf::Vertex(sf::Vector2f(x[i] + w, y[i]), sf::Vector2f(r.left + r.width, r.top)),
+            sf::Vertex(sf::Vector2f(x[i] + w, y[i] + h), sf::Vector2f(r.left + r.width, r.top + r.height)),
+            sf::Vertex(sf::Vector2f(x[i], y[i] + h), sf::Vector2f(r.left, r.top + r.height))
+        };
+
+        queue.sprite(layers[i], textures[i], quad);
     }
 
-    text.setString(s);
+    frame++;
 }
 
-bool ActorText::pass() {
-    return false;
+std::size_t World::size() const {
+    return entities.size();
 }
 
-class Score : public ActorText {
-    ~Score();
-public:
+//SpriteHandle lets actor code keep its sf::Sprite style calls while the data lives in the World
+class SpriteHandle {
+    World& world;
 
-    Score();
-    void execute() override;
-    virtual bool pass() override;
+public:
+    const Entity entity;
+
+    SpriteHandle(World& world, int layer);
+    ~SpriteHandle();
+    void setPosition(float px, float py);
+    void setPosition(sf::Vector2f p);
+    sf::Vector2f getPosition() const;
+    void setScale(float sx, float sy);
+    sf::Vector2f getScale() const;
+    sf::FloatRect getLocalBounds() const;
+    sf::FloatRect getGlobalBounds() const;
+    void setLayer(int layer);
 };
 
-Score::Score() : ActorText("./Assets/Fonts/FredokaOne-Regular.ttf", std::to_string(score)) {
-    text.setCharacterSize(64);
-}
-
-Score::~Score() {};
+SpriteHandle::SpriteHandle(World& world, int layer) :
+    world(world),
+    entity(world.create(layer))
+{}
 
-void Score::execute() {
-    text.setString(std::to_string(score));
-    
-    ActorText::draw();
+SpriteHandle::~SpriteHandle() {
+    world.destroy(entity);
 }
 
-bool Score::pass() {
-    return false;
+void SpriteHandle::setPosition(float px, float py) {
+    world.setPosition(entity, sf::Vector2f(px, py));
 }
 
-class Title : public ActorSprite {
-    ~Title();
+void SpriteHandle::setPosition(sf::Vector2f p) {
+    world.setPosition(entity, p);
+}
 
-public:
-    int value = 0;
+sf::Vector2f SpriteHandle::getPosition() const {
+    return world.getPosition(entity);
+}
 
-    Title();
-    void execute() override;
-    virtual bool pass() override;
-};
+void SpriteHandle::setScale(float sx, float sy) {
+    world.setScale(entity, sf::Vector2f(sx, sy));
+}
 
-Title::Title() : ActorSprite("./Assets/GUI/Title.png") {
-    sprite.setPosition(engine.window.getSize().x / 2 - sprite.getLocalBounds().width / 2,
-        engine.window.getSize().y / 2 - sprite.getLocalBounds().height / 2 - 333);
+sf::Vector2f SpriteHandle::getScale() const {
+    return world.getScale(entity);
 }
 
-Title::~Title() {}
+sf::FloatRect SpriteHandle::getLocalBounds() const {
+    sf::Vector2f size = world.getSize(entity);
+    return sf::FloatRect(0.f, 0.f, size.x, size.y);
+}
 
-void Title::execute() {
-    ActorSprite::draw();
+sf::FloatRect SpriteHandle::getGlobalBounds() const {
+    sf::Vector2f p = world.getPosition(entity);
+    sf::Vector2f size = world.getSize(entity);
+    sf::Vector2f scale = world.getScale(entity);
+    return sf::FloatRect(p.x, p.y, size.x * scale.x, size.y * scale.y);
 }
 
-bool Title::pass() {
-    return true;
+void SpriteHandle::setLayer(int layer) {
+    world.setLayer(entity, layer);
 }
 
-class PlayButton : public ActorSprite {
-    ~PlayButton();
+//TextureRegistry is a singleton, each image is uploaded once and shared by every entity that shows it
+class TextureRegistry {
+    std::map<std::string, sf::Texture> textures;
 
-public:
-    int value = 0;
+    TextureRegistry() {}
 
-    PlayButton();
-    void execute() override;
-    virtual bool pass() override;
+public:
+    TextureRegistry(TextureRegistry& other) = delete;
+    void operator=(const TextureRegistry&) = delete;
+    static TextureRegistry& instance();
+    sf::Texture* get(const std::string& fp);
 };
 
-PlayButton::PlayButton() : ActorSprite("./Assets/GUI/Play.png") {
-    sprite.setPosition(engine.window.getSize().x / 2 - sprite.getLocalBounds().width / 2,
-        engine.window.getSize().y / 2 - sprite.getLocalBounds().height / 2);
+TextureRegistry& TextureRegistry::instance() {
+    static TextureRegistry* registry = new TextureRegistry();
+    return *registry;
 }
 
-PlayButton::~PlayButton() {}
+sf::Texture* TextureRegistry::get(const std::string& fp) {
+    std::map<std::string, sf::Texture>::iterator it = textures.find(fp);
 
-void PlayButton::execute() {
-    static float timer = 0.3f;
+    if (it == textures.end()) {
+        it = textures.insert(std::make_pair(fp, sf::Texture())).first;
 
-    if (timer > 0.3f && engine.event.type == sf::Event::MouseButtonPressed && sprite.getGlobalBounds().contains(engine.getMousePosition())) {
-        value = 1;
-        timer = 0.3;
+        if (!it->second.loadFromFile(fp)) {
+            textures.erase(it);
+            return nullptr;
+        }
+
+        it->second.setSmooth(true);
     }
-    else
-        timer += engine.deltaTime;
 
-    ActorSprite::draw();
+    return &it->second;
 }
 
-bool PlayButton::pass() {
-    return true;
-}
+//Tweens keeps every running animation in parallel arrays and advances all of them in one pass per frame
+class Tweens {
+public:
+    enum EASING {
+        Linear,
+        QuadOut,
+        CubicInOut,
+        BackOut
+    };
 
+private:
+    World& world;
+    std::vector<Entity> targets;
+    std::vector<sf::Vector2f> from;
+    std::vector<sf::Vector2f> to;
+    std::vector<float> elapsed;
+    std::vector<float> inverseDuration;
+    std::vector<float> progress;
+    std::vector<unsigned char> easing;
+    std::vector<float> eased;
+    std::vector<sf::Vector2f> current;
+
+    static float ease(unsigned char e, float t);
+    void remove(std::size_t i);
 
-class Cursor : public ActorSprite {
-    ~Cursor();
 public:
-    Cursor();
-    void execute() override;
-    virtual bool pass() override;
+    Tweens(World& world);
+    void add(Entity target, sf::Vector2f a, sf::Vector2f b, float duration, EASING e, float delay = 0.f);
+    void cancel(Entity target);
+    void update(float dt);
+    void clear();
+    std::size_t size() const;
 };
 
-Cursor::Cursor() : ActorSprite("./Assets/GUI/Pick.png") {
+Tweens::Tweens(World& world) :
+    world(world)
+{}
+
+float Tweens::ease(unsigned char e, float t) {
+    switch (e) {
+    case QuadOut:
+        return t * (2.f - t);
+    case CubicInOut:
+        return t < 0.5f ? 4.f * t * t * t : 1.f + 4.f * (t - 1.f) * (t - 1.f) * (t - 1.f);
+    case BackOut:
+        return 1.f + 2.70158f * (t - 1.f) * (t - 1.f) * (t - 1.f) + 1.70158f * (t - 1.f) * (t - 1.f);
+    default:
+        return t;
+    }
 }
 
-Cursor::~Cursor() {}
+//Swaps the last tween into the hole so the arrays stay dense
+void Tweens::remove(std::size_t i) {
+    std::size_t last = targets.size() - 1;
+
+    targets[i] = targets[last];
+    from[i] = from[last];
+    to[i] = to[last];
+    elapsed[i] = elapsed[last];
+    inverseDuration[i] = inverseDuration[last];
+    progress[i] = progress[last];
+    easing[i] = easing[last];
+
+    targets.pop_back();
+    from.pop_back();
+    to.pop_back();
+    elapsed.pop_back();
+    inverseDuration.pop_back();
+    progress.pop_back();
+    easing.pop_back();
+}
 
-void Cursor::execute() {
-    sprite.setPosition(engine.getMousePosition());
-    ActorSprite::draw();
+//A delay is stored as negative elapsed time, the target holds its start position until it runs out
+void Tweens::add(Entity target, sf::Vector2f a, sf::Vector2f b, float duration, EASING e, float delay) {
+    targets.push_back(target);
+    from.push_back(a);
+    to.push_back(b);
+    elapsed.push_back(-delay);
+    inverseDuration.push_back(duration > 0.f ? 1.f / duration : INFINITY);
+    progress.push_back(0.f);
+    easing.push_back((unsigned char)e);
 }
 
-bool Cursor::pass() {
-    return false;
+void Tweens::cancel(Entity target) {
+    for (std::size_t i = targets.size(); i-- > 0;)
+        if (targets[i] == target)
+            remove(i);
 }
 
-class Board : public ActorSprite {
-    friend class Piece;
+void Tweens::update(float dt) {
+    std::size_t n = targets.size();
 
-    ~Board();
+    if (n == 0)
+        return;
 
-public:
-    sf::RectangleShape line[2];
-    int selection[2];
-    Board();
-    void addSelection();
-    void execute() override;
-    virtual bool pass() override;
-};
+    for (std::size_t i = 0; i < n; i++) {
+        elapsed[i] += dt;
+        progress[i] = std::min(std::max(elapsed[i] * inverseDuration[i], 0.f), 1.f);
+    }
 
-Board::Board() : ActorSprite("./Assets/Sprites/Board.png"),
-line{sf::RectangleShape(sf::Vector2f(128.f, 128.f)), sf::RectangleShape(sf::Vector2f(128.f, 128.f))},
-selection{ 0, 0 } {
-    sprite.setPosition(engine.window.getSize().x / 2 - sprite.getLocalBounds().width / 2,
-        engine.window.getSize().y / 2 - sprite.getLocalBounds().height / 2);
-    line[0].setFillColor(sf::Color::Transparent);
-    line[1].setFillColor(sf::Color::Transparent);
+    eased.resize(n);
+    current.resize(n);
+
+    for (std::size_t i = 0; i < n; i++)
+        eased[i] = ease(easing[i], progress[i]);
+
+    Utilities::lerp(from.data(), to.data(), eased.data(), current.data(), n);
+
+    for (std::size_t i = 0; i < n; i++)
+        world.setPosition(targets[i], current[i]);
+
+    for (std::size_t i = n; i-- > 0;)
+        if (progress[i] >= 1.f)
+            remove(i);
 }
 
-Board::~Board() {}
+void Tweens::clear() {
+    targets.clear();
+    from.clear();
+    to.clear();
+    elapsed.clear();
+    inverseDuration.clear();
+    progress.clear();
+    easing.clear();
+}
 
-void Board::addSelection() {
-    static int index = 0;
+std::size_t Tweens::size() const {
+    return targets.size();
+}
 
-    if (index > 1){
-        index = 0;
-    }
+//Layout letterboxes the 1920x1080 logical canvas inside the window and caches every anchor once per resize
+class Layout {
+    mutable std::map<std::string, bool> found;
 
-    for (int i = 1; i <= 8; i++) {
-        line[index].setPosition((i - 1) * 128 + sprite.getPosition().x, 0);
-        if ((i) * 128 + engine.window.getSize().x / 2 - sprite.getLocalBounds().width / 2 > engine.getMousePosition().x)
-            break;
-        selection[index] = i * 100;
-    }
+public:
+    static const float WIDTH;
+    static const float HEIGHT;
+
+    sf::FloatRect viewport;
+    float scale;
+    float factor;
+    const char* suffix;
+    unsigned int revision;
+
+    sf::Vector2f center;
+    sf::Vector2f title;
+    sf::Vector2f board;
+    sf::Vector2f bar;
+    sf::Vector2f score;
+    sf::Vector2f timer;
+    sf::Vector2f level;
+    sf::Vector2f race;
+
+    Layout();
+    void resize(sf::Vector2u size);
+    std::string asset(const std::string& fp, float& scaleFactor) const;
+};
 
-    for (int i = 1; i <= 8; i++) {
-        line[index].setPosition(line[index].getPosition().x, (i - 1) * 128 + sprite.getPosition().y);
-        if ((i) * 128 + engine.window.getSize().y / 2 - sprite.getLocalBounds().height / 2 > engine.getMousePosition().y)
-            break;
-        selection[index]++;
-    }
+const float Layout::WIDTH = 1920.f;
+const float Layout::HEIGHT = 1080.f;
 
-    selection[index] += 101;
+Layout::Layout() :
+    viewport(0.f, 0.f, 1.f, 1.f),
+    scale(1.f),
+    factor(1.f),
+    suffix(""),
+    revision(0)
+{}
 
-    index++;
-}
+void Layout::resize(sf::Vector2u size) {
+    float aspect = (float)size.x / size.y;
+    float target = WIDTH / HEIGHT;
 
-void Board::execute() {
-    static float timer = 0.3f;
+    if (aspect > target)
+        viewport = sf::FloatRect((1.f - target / aspect) / 2, 0.f, target / aspect, 1.f);
+    else
+        viewport = sf::FloatRect(0.f, (1.f - aspect / target) / 2, 1.f, aspect / target);
 
-    if (timer > 0.3f && engine.event.type == sf::Event::MouseButtonPressed && sprite.getGlobalBounds().contains(engine.getMousePosition())) {
-        addSelection();
+    scale = std::min(size.x / WIDTH, size.y / HEIGHT);
 
-        timer = 0.f;
+    //Textures come from the closest pre-scaled set so they are never sampled far from their native size
+    if (scale <= 0.75f) {
+        factor = 0.5f;
+        suffix = "@0.5x";
+    }
+    else if (scale >= 1.5f) {
+        factor = 2.f;
+        suffix = "@2x";
+    }
+    else {
+        factor = 1.f;
+        suffix = "";
     }
-    else
-        timer += engine.deltaTime;
 
-    ActorSprite::draw();
-    Engine::instance().window.draw(line[0]);
-    Engine::instance().window.draw(line[1]);
+    center = sf::Vector2f(WIDTH / 2, HEIGHT / 2);
+    title = center - sf::Vector2f(0.f, 333.f);
+    board = center;
+    bar = sf::Vector2f(0.f, HEIGHT - 24);
+    score = sf::Vector2f(0.f, 0.f);
+    timer = sf::Vector2f(WIDTH - 100, 0.f);
+    level = sf::Vector2f(WIDTH / 2 - 60, 8.f);
+    race = sf::Vector2f(0.f, 80.f);
+
+    revision++;
 }
 
-bool Board::pass() {
+//Resolves "./Assets/Sprites/Pieces.png" to "./Assets/Sprites@2x/Pieces.png" when the tier's set exists
+std::string Layout::asset(const std::string& fp, float& scaleFactor) const {
+    std::string::size_type slash = fp.find_last_of('/');
+    scaleFactor = 1.f;
+
+    if (factor == 1.f || slash == std::string::npos)
+        return fp;
+
+    std::string scaled = fp.substr(0, slash) + suffix + fp.substr(slash);
+    std::map<std::string, bool>::iterator it = found.find(scaled);
+
+    if (it == found.end())
+        it = found.insert(std::make_pair(scaled, std::ifstream(scaled).good())).first;
+
+    if (!it->second)
+        return fp;
+
+    scaleFactor = factor;
+    return scaled;
+}
+
+//Engine is a singleton
+class Engine {
+    static Engine* engine;
+
+    sf::VideoMode video;
+    sf::Clock clock;
+    sf::Event pendingEvent;
+    bool pending;
+    sf::Cursor pointer;
+
+    Engine();
+
+public:
+    sf::RenderWindow window;
+    sf::View view;
+    sf::Event event;
+    Layout layout;
+    World world;
+    Tweens tweens;
+    RenderQueue queue;
+
+    float deltaTime;
+    bool nativeCursor;
+
+    Engine(Engine& other) = delete;
+    void operator=(const Engine&) = delete;
+    static Engine& instance();
+    void render(const sf::Drawable& drawable, int layer, const sf::RenderStates& states = sf::RenderStates::Default);
+    void present();
+    sf::Event& next();
+    sf::Vector2f getMousePosition();
+    bool setCursor(const std::string& fp);
+};
+
+Engine::Engine():
+    video(std::min(sf::VideoMode::getDesktopMode().width, 1920u), std::min(sf::VideoMode::getDesktopMode().height, 1080u)),
+    pending(false),
+    window(this->video, "Best Move"),
+    view(sf::FloatRect(0, 0, Layout::WIDTH, Layout::HEIGHT)),
+    tweens(world),
+    deltaTime(0.f),
+    nativeCursor(false)
+{
+    srand(time(NULL));
+    layout.resize(window.getSize());
+    view.setViewport(layout.viewport);
+    window.setView(view);
+    window.setKeyRepeatEnabled(false);
+}
+
+Engine& Engine::instance() {
+    static Engine* engine = new Engine();
+    return *engine;
+}
+
+//Hands the image to the OS as the pointer, the hotspot is its top left corner like the sprite it replaces
+bool Engine::setCursor(const std::string& fp)
+{
+    if (nativeCursor)
+        return true;
+
+    sf::Image image;
+
+    if (!image.loadFromFile(fp) || !pointer.loadFromPixels(image.getPixelsPtr(), image.getSize(), sf::Vector2u(0, 0))) {
+        window.setMouseCursorVisible(false);
+        return false;
+    }
+
+    window.setMouseCursor(pointer);
+    window.setMouseCursorVisible(true);
+    nativeCursor = true;
+    return true;
+}
+
+//Drawables wait in the render queue until present, where they land on top of their layer's sprites
+void Engine::render(const sf::Drawable& drawable, int layer, const sf::RenderStates& states)
+{
+    queue.drawable(layer, drawable, states);
+}
+
+void Engine::present()
+{
+    world.render(queue);
+    queue.submit(window);
+    window.display();
+}
+
+sf::Event& Engine::next()
+{
+    deltaTime = clock.restart().asSeconds();
+
+    if (pending) {
+        event = pendingEvent;
+        pending = false;
+    }
+    else if (!window.pollEvent(event))
+        event.type = sf::Event::Count;
+
+    //Mouse moves are coalesced so dragging never queues events up behind the frame rate
+    while (event.type == sf::Event::MouseMoved && window.pollEvent(pendingEvent)) {
+        if (pendingEvent.type != sf::Event::MouseMoved) {
+            pending = true;
+            break;
+        }
+
+        event = pendingEvent;
+    }
+
+    if (event.type == sf::Event::Resized) {
+        layout.resize(sf::Vector2u(event.size.width, event.size.height));
+        view.setViewport(layout.viewport);
+        window.setView(view);
+    }
+
+    window.clear();
+    
+    return event;
+}
+
+sf::Vector2f Engine::getMousePosition() {
+    return window.mapPixelToCoords(sf::Mouse::getPosition(window));
+}
+
+//FontRegistry is a singleton, each font file is parsed once per process and shared by every text
+class FontRegistry {
+    std::map<std::string, sf::Font> fonts;
+
+    FontRegistry() {}
+
+public:
+    FontRegistry(FontRegistry& other) = delete;
+    void operator=(const FontRegistry&) = delete;
+    static FontRegistry& instance();
+    sf::Font* get(const std::string& fp);
+    void warm(const std::string& fp, unsigned int characterSize, const std::string& characters);
+};
+
+FontRegistry& FontRegistry::instance() {
+    static FontRegistry* registry = new FontRegistry();
+    return *registry;
+}
+
+sf::Font* FontRegistry::get(const std::string& fp) {
+    std::map<std::string, sf::Font>::iterator it = fonts.find(fp);
+
+    if (it == fonts.end()) {
+        it = fonts.insert(std::make_pair(fp, sf::Font())).first;
+
+        if (!it->second.loadFromFile(fp)) {
+            fonts.erase(it);
+            return nullptr;
+        }
+    }
+
+    return &it->second;
+}
+
+//Rasterizes the glyphs up front so drawing them later never touches FreeType or grows the atlas
+void FontRegistry::warm(const std::string& fp, unsigned int characterSize, const std::string& characters) {
+    sf::Font* font = get(fp);
+
+    if (font == nullptr)
+        return;
+
+    for (char c : characters)
+        font->getGlyph(static_cast<unsigned char>(c), characterSize, false);
+}
+
+class Actor {
+    friend class Game;
+
+protected:
+    Actor();
+    virtual ~Actor() {};
+
+    Engine& engine;
+
+public:
+    virtual bool pass() = 0;
+    virtual void execute() = 0;
+};
+
+Actor::Actor() :
+    engine(Engine::instance())
+{}
+
+//ActorSprite is the compatibility shim over the World, its sprite is a handle to an entity. It keeps what it loaded so
+//a resize that changes the DPI tier swaps the texture set under actors that live across levels
+class ActorSprite : public Actor {
+    std::string file;
+    sf::IntRect rect;
+    unsigned int loaded;
+
+protected:
+    SpriteHandle sprite;
+
+    ActorSprite(std::string fp, int layer);
+    ActorSprite(std::string fp, int x, int y, int w, int h, int layer);
+    ActorSprite(std::string fp, sf::IntRect ir, int layer);
+    virtual ~ActorSprite();
+    void load(const std::string& fp, const sf::IntRect& ir);
+    sf::Vector2f size();
+    void draw();
+    virtual bool pass() override;
+};
+
+ActorSprite::ActorSprite(std::string fp, int layer) :
+    loaded(0),
+    sprite(engine.world, layer) {
+    load(fp, sf::IntRect());
+}
+
+ActorSprite::ActorSprite(std::string fp, int x, int y, int w, int h, int layer) :
+    loaded(0),
+    sprite(engine.world, layer) {
+    load(fp, sf::IntRect(x, y, w, h));
+}
+
+ActorSprite::ActorSprite(std::string fp, sf::IntRect ir, int layer) :
+    loaded(0),
+    sprite(engine.world, layer) {
+    load(fp, ir);
+}
+
+ActorSprite::~ActorSprite() {}
+
+//Rects and sizes stay in logical pixels, a texture from a pre-scaled set is scaled back down by its factor
+void ActorSprite::load(const std::string& fp, const sf::IntRect& ir) {
+    file = fp;
+    rect = ir;
+    loaded = engine.layout.revision;
+
+    float factor;
+    std::string path = engine.layout.asset(fp, factor);
+    sf::IntRect scaled((int)(ir.left * factor), (int)(ir.top * factor), (int)(ir.width * factor), (int)(ir.height * factor));
+
+    if (sf::Texture* texture = TextureRegistry::instance().get(path))
+    {
+        engine.world.setTexture(sprite.entity, texture, scaled);
+        sprite.setScale(1.f / factor, 1.f / factor);
+    }
+}
+
+sf::Vector2f ActorSprite::size() {
+    sf::FloatRect bounds = sprite.getLocalBounds();
+    return sf::Vector2f(bounds.width * sprite.getScale().x, bounds.height * sprite.getScale().y);
+}
+
+void ActorSprite::draw() {
+    if (loaded != engine.layout.revision)
+        load(file, rect);
+
+    engine.world.show(sprite.entity);
+}
+
+bool ActorSprite::pass() {
+    return true;
+}
+
+class ActorText : public Actor {
+protected:
+    sf::Text text;
+
+    ActorText(std::string fp);
+    ActorText(std::string fp, std::string s);
+    virtual ~ActorText();
+    void draw();
+    virtual bool pass() override;
+};
+
+void ActorText::draw() {
+    engine.render(text, LayerHud);
+}
+
+ActorText::~ActorText() {}
+
+ActorText::ActorText(std::string fp) {
+    if (sf::Font* font = FontRegistry::instance().get(fp))
+    {
+        text.setFont(*font);
+    }
+}
+
+ActorText::ActorText(std::string fp, std::string s) {
+    if (sf::Font* font = FontRegistry::instance().get(fp))
+    {
+        text.setFont(*font);
+    }
+
+    text.setString(s);
+}
+
+bool ActorText::pass() {
     return false;
-}   
+}
+
+//HudText formats an integer into a stack buffer and only rebuilds its string and geometry when the value changes
+class HudText : public ActorText {
+    const char* format;
+    int shown;
+    bool valid;
+
+protected:
+    virtual ~HudText();
+
+public:
+    HudText(const char* format, unsigned int characterSize, sf::Vector2f position);
+    void set(int value);
+    void execute() override;
+    virtual bool pass() override;
+};
+
+HudText::HudText(const char* format, unsigned int characterSize, sf::Vector2f position) : ActorText(FONTPATH),
+    format(format),
+    shown(0),
+    valid(false) {
+    text.setCharacterSize(characterSize);
+    text.setPosition(position);
+}
+
+HudText::~HudText() {}
+
+void HudText::set(int value) {
+    if (valid && value == shown)
+        return;
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), format, value);
+    text.setString(buffer);
+
+    shown = value;
+    valid = true;
+}
+
+void HudText::execute() {
+    ActorText::draw();
+}
+
+bool HudText::pass() {
+    return false;
+}
+
+class Title : public ActorSprite {
+    ~Title();
+
+public:
+    int value = 0;
+
+    Title();
+    void execute() override;
+    virtual bool pass() override;
+};
+
+Title::Title() : ActorSprite("./Assets/GUI/Title.png", LayerPieces) {
+    sprite.setPosition(engine.layout.title - size() / 2.f);
+}
+
+Title::~Title() {}
+
+void Title::execute() {
+    ActorSprite::draw();
+}
+
+bool Title::pass() {
+    return true;
+}
+
+class PlayButton : public ActorSprite {
+    ~PlayButton();
+
+public:
+    int value = 0;
+
+    PlayButton();
+    void execute() override;
+    virtual bool pass() override;
+};
+
+PlayButton::PlayButton() : ActorSprite("./Assets/GUI/Play.png", LayerPieces) {
+    sprite.setPosition(engine.layout.center - size() / 2.f);
+}
+
+PlayButton::~PlayButton() {}
+
+void PlayButton::execute() {
+    static float timer = 0.3f;
+
+    if (timer > 0.3f && engine.event.type == sf::Event::MouseButtonPressed && sprite.getGlobalBounds().contains(engine.getMousePosition())) {
+        value = 1;
+        timer = 0.3;
+    }
+    else
+        timer += engine.deltaTime;
+
+    ActorSprite::draw();
+}
+
+bool PlayButton::pass() {
+    return true;
+}
+
+
+class Cursor : public ActorSprite {
+    ~Cursor();
+public:
+    Cursor();
+    void execute() override;
+    virtual bool pass() override;
+};
+
+//The sprite only follows the mouse where the platform refuses a cursor made from pixels
+Cursor::Cursor() : ActorSprite("./Assets/GUI/Pick.png", LayerCursor) {
+    if (!engine.setCursor("./Assets/GUI/Pick.png"))
+        engine.world.setBehavior(sprite.entity, World::FollowMouse);
+}
+
+Cursor::~Cursor() {}
+
+void Cursor::execute() {
+    if (!engine.nativeCursor)
+        ActorSprite::draw();
+}
+
+bool Cursor::pass() {
+    return false;
+}
+
+class Piece;
+
+//Board maps window pixels straight to Chess::Square indices through one cached transform
+class Board : public ActorSprite {
+    friend class Piece;
+
+    sf::Transform pixelToSquare;
+    unsigned int revision;
+    Piece* pieces[64];
+    Piece* dragged;
+    Chess::Square pressed;
+
+    ~Board();
+    void updateTransform();
+    void press(Chess::Square s);
+    void release(Chess::Square s);
+
+public:
+    static const float TILESIZE;
+
+    sf::RectangleShape line[2];
+    sf::RectangleShape hint[2];
+    Chess::Square selection[2];
+    bool moved;
+
+    Board();
+    Chess::Square squareAt(int x, int y);
+    sf::Vector2f squarePosition(Chess::Square s);
+    Piece* pieceAt(Chess::Square s);
+    void movePiece(Chess::Square from, Chess::Square to, float delay = 0.f);
+    void playMove(Chess::Move m, float delay = 0.f);
+    void clearPieces();
+    void clearSelection();
+    void showHint(int stage, Chess::Square s);
+    void clearHint();
+    void execute() override;
+    virtual bool pass() override;
+};
 
 class Piece : public ActorSprite {
+    float removal;
+    float promotion;
+    int promoted;
+
     ~Piece();
 public:
     enum PIECE{
@@ -400,11 +1370,205 @@ public:
     Board& board;
 
     sf::IntRect pieceRect(int i);
-    Piece(Board& b, int i, int x, int y);
+    Piece(Board& b, int i, Chess::Square s);
+    void place(sf::Vector2f position);
+    void lift(bool lifted);
+    void animate(sf::Vector2f target, float delay);
+    void capture(float delay);
+    void promote(int i, float delay);
     void execute() override;
     virtual bool pass() override;
 };
 
+const float Board::TILESIZE = 128.f;
+
+Board::Board() : ActorSprite("./Assets/Sprites/Board.png", LayerBoard),
+revision(0),
+pieces(),
+dragged(nullptr),
+pressed(Chess::NO_SQUARE),
+line{sf::RectangleShape(sf::Vector2f(TILESIZE, TILESIZE)), sf::RectangleShape(sf::Vector2f(TILESIZE, TILESIZE))},
+hint{sf::RectangleShape(sf::Vector2f(TILESIZE, TILESIZE)), sf::RectangleShape(sf::Vector2f(TILESIZE, TILESIZE))},
+selection{ Chess::NO_SQUARE, Chess::NO_SQUARE },
+moved(false) {
+    sprite.setPosition(engine.layout.board - size() / 2.f);
+    line[0].setFillColor(sf::Color::Transparent);
+    line[1].setFillColor(sf::Color::Transparent);
+    clearHint();
+    updateTransform();
+}
+
+Board::~Board() {}
+
+//Folds viewport, inverse view and board placement into one transform from window pixels to square units
+void Board::updateTransform() {
+    revision = engine.layout.revision;
+
+    sf::IntRect viewport = engine.window.getViewport(engine.view);
+    float w = (float)viewport.width;
+    float h = (float)viewport.height;
+    sf::Transform pixelToNdc(2.f / w, 0.f, -1.f - 2.f * viewport.left / w,
+        0.f, -2.f / h, 1.f + 2.f * viewport.top / h,
+        0.f, 0.f, 1.f);
+
+    sf::Transform coordsToSquare;
+    coordsToSquare.scale(1.f / TILESIZE, 1.f / TILESIZE).translate(-sprite.getPosition());
+
+    pixelToSquare = coordsToSquare * engine.view.getInverseTransform() * pixelToNdc;
+}
+
+Chess::Square Board::squareAt(int x, int y) {
+    sf::Vector2f p = pixelToSquare.transformPoint((float)x, (float)y);
+    int file = (int)std::floor(p.x);
+    int rank = 7 - (int)std::floor(p.y);
+
+    return Chess::isSquare(file, rank) ? Chess::makeSquare(file, rank) : Chess::NO_SQUARE;
+}
+
+sf::Vector2f Board::squarePosition(Chess::Square s) {
+    return sprite.getPosition() + sf::Vector2f(Chess::fileOf(s) * TILESIZE, (7 - Chess::rankOf(s)) * TILESIZE);
+}
+
+Piece* Board::pieceAt(Chess::Square s) {
+    return s == Chess::NO_SQUARE ? nullptr : pieces[s];
+}
+
+//Slides the piece to its new square, a captured piece disappears when the mover lands on it
+void Board::movePiece(Chess::Square from, Chess::Square to, float delay) {
+    Piece* p = pieces[from];
+
+    if (p == nullptr)
+        return;
+
+    if (pieces[to] != nullptr)
+        pieces[to]->capture(delay + MOVETIME);
+
+    pieces[from] = nullptr;
+    pieces[to] = p;
+    p->animate(squarePosition(to), delay);
+}
+
+//The whole of a chess move: the rook of a castle, the pawn taken en passant and the piece a pawn turns into
+void Board::playMove(Chess::Move m, float delay) {
+    Chess::Square from = Chess::fromOf(m);
+    Chess::Square to = Chess::toOf(m);
+
+    if (Chess::flagOf(m) == Chess::EnPassant) {
+        Chess::Square victim = Chess::makeSquare(Chess::fileOf(to), Chess::rankOf(from));
+
+        if (pieces[victim] != nullptr)
+            pieces[victim]->capture(delay + MOVETIME);
+
+        pieces[victim] = nullptr;
+    }
+
+    movePiece(from, to, delay);
+
+    if (Chess::flagOf(m) == Chess::Castle)
+        movePiece(to > from ? to + 1 : to - 2, to > from ? to - 1 : to + 1, delay);
+
+    if (Chess::flagOf(m) == Chess::Promotion && pieces[to] != nullptr)
+        pieces[to]->promote(Chess::makePiece(Chess::rankOf(to) == 7 ? Chess::White : Chess::Black, Chess::promotionOf(m)), delay + MOVETIME);
+}
+
+void Board::clearPieces() {
+    for (Piece*& p : pieces)
+        p = nullptr;
+
+    dragged = nullptr;
+}
+
+void Board::clearSelection() {
+    selection[0] = Chess::NO_SQUARE;
+    selection[1] = Chess::NO_SQUARE;
+    pressed = Chess::NO_SQUARE;
+    moved = false;
+}
+
+//Stage 0 marks the piece to move and stage 1 the square it goes to
+void Board::showHint(int stage, Chess::Square s) {
+    hint[stage].setPosition(squarePosition(s));
+    hint[stage].setFillColor(sf::Color(64, 160, 255, 128));
+}
+
+void Board::clearHint() {
+    hint[0].setFillColor(sf::Color::Transparent);
+    hint[1].setFillColor(sf::Color::Transparent);
+}
+
+//A press either starts a new move or, with a square already picked, completes a click-click move
+void Board::press(Chess::Square s) {
+    if (selection[0] == Chess::NO_SQUARE || selection[1] != Chess::NO_SQUARE) {
+        clearSelection();
+        selection[0] = s;
+        line[0].setPosition(squarePosition(s));
+        pressed = s;
+        dragged = pieces[s];
+
+        if (dragged != nullptr)
+            dragged->lift(true);
+        return;
+    }
+
+    selection[1] = s;
+    line[1].setPosition(squarePosition(s));
+    moved = true;
+}
+
+//Releasing a dragged piece on another square completes the move, releasing in place leaves it picked
+void Board::release(Chess::Square s) {
+    if (dragged != nullptr) {
+        dragged->place(squarePosition(pressed));
+        dragged->lift(false);
+    }
+
+    dragged = nullptr;
+
+    if (pressed == Chess::NO_SQUARE || s == Chess::NO_SQUARE || s == pressed || selection[1] != Chess::NO_SQUARE)
+        return;
+
+    selection[1] = s;
+    line[1].setPosition(squarePosition(s));
+    moved = true;
+}
+
+void Board::execute() {
+    if (engine.layout.revision != revision)
+        updateTransform();
+
+    switch (engine.event.type) {
+    case sf::Event::MouseButtonPressed:
+        if (engine.event.mouseButton.button == sf::Mouse::Left) {
+            Chess::Square s = squareAt(engine.event.mouseButton.x, engine.event.mouseButton.y);
+
+            if (s != Chess::NO_SQUARE)
+                press(s);
+        }
+        break;
+    case sf::Event::MouseButtonReleased:
+        if (engine.event.mouseButton.button == sf::Mouse::Left)
+            release(squareAt(engine.event.mouseButton.x, engine.event.mouseButton.y));
+        break;
+    case sf::Event::MouseMoved:
+        if (dragged != nullptr)
+            dragged->place(engine.window.mapPixelToCoords(sf::Vector2i(engine.event.mouseMove.x, engine.event.mouseMove.y)) -
+                sf::Vector2f(TILESIZE / 2, TILESIZE / 2));
+        break;
+    default:
+        break;
+    }
+
+    ActorSprite::draw();
+    engine.render(hint[0], LayerHighlight);
+    engine.render(hint[1], LayerHighlight);
+    engine.render(line[0], LayerHighlight);
+    engine.render(line[1], LayerHighlight);
+}
+
+bool Board::pass() {
+    return false;
+}   
+
 sf::IntRect Piece::pieceRect(int i) {
     const int TILESIZE = 128;
     int x = 0, y = 0;
@@ -420,23 +1584,255 @@ sf::IntRect Piece::pieceRect(int i) {
 }
 
 
-Piece::Piece(Board& b, int i, int x, int y) : ActorSprite("./Assets/Sprites/Pieces.png", pieceRect(i)),
+Piece::Piece(Board& b, int i, Chess::Square s) : ActorSprite("./Assets/Sprites/Pieces.png", pieceRect(i), LayerPieces),
+    removal(-1.f),
+    promotion(-1.f),
+    promoted(i),
     board(b) {
-    const int TILESIZE = 128;
-
-    sprite.setPosition(sf::Vector2f((x - 1) * TILESIZE, (y - 1) * TILESIZE) + board.sprite.getPosition());
+    board.pieces[s] = this;
+    sprite.setPosition(board.squarePosition(s));
 }
 
 Piece::~Piece() {}
 
+void Piece::place(sf::Vector2f position) {
+    engine.tweens.cancel(sprite.entity);
+    sprite.setPosition(position);
+}
+
+void Piece::lift(bool lifted) {
+    sprite.setLayer(lifted ? LayerDrag : LayerPieces);
+}
+
+void Piece::animate(sf::Vector2f target, float delay) {
+    engine.tweens.cancel(sprite.entity);
+    engine.tweens.add(sprite.entity, sprite.getPosition(), target, MOVETIME, Tweens::CubicInOut, delay);
+}
+
+void Piece::capture(float delay) {
+    removal = delay;
+}
+
+//The sprite changes once the pawn has arrived on its last rank
+void Piece::promote(int i, float delay) {
+    promoted = i;
+    promotion = delay;
+}
+
 void Piece::execute() {
-    ActorSprite::draw();
+    if (removal >= 0.f) {
+        removal -= engine.deltaTime;
+
+        if (removal < 0.f)
+            removal = 0.f;
+    }
+
+    if (promotion >= 0.f) {
+        promotion -= engine.deltaTime;
+
+        if (promotion < 0.f)
+            load("./Assets/Sprites/Pieces.png", pieceRect(promoted));
+    }
+
+    if (removal != 0.f)
+        ActorSprite::draw();
 }
 
 bool Piece::pass() {
     return true;
 }
 
+//ParticlePool keeps particles in parallel arrays, the live ones packed at the front of a fixed capacity
+class ParticlePool {
+    std::size_t capacity;
+    std::size_t alive;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<float> life;
+    std::vector<float> inverseLife;
+    std::vector<float> angle;
+    std::vector<float> spin;
+    std::vector<sf::Color> color;
+    std::vector<unsigned char> cell;
+    std::minstd_rand recycle;
+
+    void kill(std::size_t i);
+
+public:
+    static const float GRAVITY;
+    static const float DRAG;
+    static const float SIZE;
+
+    ParticlePool(std::size_t capacity);
+    void burst(sf::Vector2f at, int count);
+    void update(float dt);
+    void build(sf::VertexArray& vertices, float cellSize);
+    std::size_t size() const;
+};
+
+const float ParticlePool::GRAVITY = 900.f;
+const float ParticlePool::DRAG = 0.98f;
+const float ParticlePool::SIZE = 14.f;
+
+ParticlePool::ParticlePool(std::size_t capacity) :
+    capacity(capacity),
+    alive(0),
+    x(capacity), y(capacity), vx(capacity), vy(capacity),
+    life(capacity), inverseLife(capacity), angle(capacity), spin(capacity),
+    color(capacity), cell(capacity), recycle(1)
+{}
+
+void ParticlePool::kill(std::size_t i) {
+    std::size_t last = --alive;
+
+    x[i] = x[last];
+    y[i] = y[last];
+    vx[i] = vx[last];
+    vy[i] = vy[last];
+    life[i] = life[last];
+    inverseLife[i] = inverseLife[last];
+    angle[i] = angle[last];
+    spin[i] = spin[last];
+    color[i] = color[last];
+    cell[i] = cell[last];
+}
+
+//New particles take free slots from the pool, a full pool recycles random live ones instead of growing.
+//The slot comes from its own generator, rand() tops out at 32767 on MSVC and would never reach the rest of the pool
+void ParticlePool::burst(sf::Vector2f at, int count) {
+    static const sf::Color palette[] = {
+        sf::Color(255, 214, 0), sf::Color(255, 64, 96), sf::Color(64, 200, 255),
+        sf::Color(120, 255, 120), sf::Color(255, 255, 255)
+    };
+
+    std::uniform_int_distribution<std::size_t> slot(0, capacity - 1);
+
+    for (int n = 0; n < count; n++) {
+        std::size_t i = alive < capacity ? alive++ : slot(recycle);
+        float direction = Utilities::DegreesToRadians((float)(rand() % 360));
+        float speed = 200.f + rand() % 700;
+        float seconds = 1.f + (rand() % 150) / 100.f;
+
+        x[i] = at.x;
+        y[i] = at.y;
+        vx[i] = std::cos(direction) * speed;
+        vy[i] = std::sin(direction) * speed - 400.f;
+        life[i] = seconds;
+        inverseLife[i] = 1.f / seconds;
+        angle[i] = direction;
+        spin[i] = (float)(rand() % 20 - 10);
+        color[i] = palette[rand() % 5];
+        cell[i] = (unsigned char)(rand() % 2);
+    }
+}
+
+void ParticlePool::update(float dt) {
+    if (alive == 0)
+        return;
+
+    float drag = std::pow(DRAG, dt * 60.f);
+
+    for (std::size_t i = 0; i < alive; i++) {
+        vx[i] *= drag;
+        vy[i] = vy[i] * drag + GRAVITY * dt;
+        life[i] -= dt;
+    }
+
+    Utilities::integrate(x.data(), vx.data(), dt, alive);
+    Utilities::integrate(y.data(), vy.data(), dt, alive);
+    Utilities::integrate(angle.data(), spin.data(), dt, alive);
+
+    for (std::size_t i = alive; i-- > 0;)
+        if (life[i] <= 0.f)
+            kill(i);
+}
+
+//Writes one rotated, shrinking quad per live particle, cells are laid out side by side in the atlas
+void ParticlePool::build(sf::VertexArray& vertices, float cellSize) {
+    vertices.setPrimitiveType(sf::Quads);
+    vertices.resize(alive * 4);
+
+    for (std::size_t i = 0; i < alive; i++) {
+        float half = SIZE * 0.5f * std::min(life[i] * inverseLife[i] * 2.f, 1.f);
+        float c = std::cos(angle[i]) * half;
+        float s = std::sin(angle[i]) * half;
+        float u = cell[i] * cellSize;
+        sf::Vertex* quad = &vertices[i * 4];
+
+        quad[0].position = sf::Vector2f(x[i] - c + s, y[i] - s - c);
+        quad[1].position = sf::Vector2f(x[i] + c + s, y[i] + s - c);
+        quad[2].position = sf::Vector2f(x[i] + c - s, y[i] + s + c);
+        quad[3].position = sf::Vector2f(x[i] - c - s, y[i] - s + c);
+        quad[0].texCoords = sf::Vector2f(u, 0.f);
+        quad[1].texCoords = sf::Vector2f(u + cellSize, 0.f);
+        quad[2].texCoords = sf::Vector2f(u + cellSize, cellSize);
+        quad[3].texCoords = sf::Vector2f(u, cellSize);
+        quad[0].color = quad[1].color = quad[2].color = quad[3].color = color[i];
+    }
+}
+
+std::size_t ParticlePool::size() const {
+    return alive;
+}
+
+//Particles draws a whole pool as one vertex array from a small generated atlas of a square and a dot
+class Particles : public Actor {
+    static const int CELL = 8;
+
+    ParticlePool pool;
+    sf::Texture atlas;
+    sf::VertexArray vertices;
+
+    ~Particles();
+
+public:
+    Particles(std::size_t capacity);
+    void burst(sf::Vector2f at, int count);
+    void execute() override;
+    virtual bool pass() override;
+};
+
+Particles::Particles(std::size_t capacity) :
+    pool(capacity),
+    vertices(sf::Quads) {
+    sf::Image image;
+    image.create(CELL * 2, CELL, sf::Color::Transparent);
+
+    for (int py = 0; py < CELL; py++) {
+        for (int px = 0; px < CELL; px++) {
+            float dx = px - CELL / 2 + 0.5f;
+            float dy = py - CELL / 2 + 0.5f;
+            float d = std::sqrt(dx * dx + dy * dy) / (CELL / 2);
+
+            image.setPixel(px, py, sf::Color::White);
+            image.setPixel(CELL + px, py, sf::Color(255, 255, 255, (sf::Uint8)(255 * std::max(0.f, 1.f - d))));
+        }
+    }
+
+    atlas.loadFromImage(image);
+    atlas.setSmooth(true);
+}
+
+Particles::~Particles() {}
+
+void Particles::burst(sf::Vector2f at, int count) {
+    pool.burst(at, count);
+}
+
+void Particles::execute() {
+    pool.update(engine.deltaTime);
+    pool.build(vertices, (float)CELL);
+
+    if (vertices.getVertexCount() > 0)
+        engine.render(vertices, LayerEffects, sf::RenderStates(&atlas));
+}
+
+bool Particles::pass() {
+    return false;
+}
+
 class Background : public ActorSprite {
     ~Background();
 public:
@@ -445,7 +1841,7 @@ public:
     virtual bool pass() override;
 };
 
-Background::Background() : ActorSprite("./Assets/Background/Background.jpg") {}
+Background::Background() : ActorSprite("./Assets/Background/Background.jpg", LayerBackground) {}
 
 Background::~Background() {}
 
@@ -457,19 +1853,276 @@ bool Background::pass() {
     return false;
 }
 
+//MusicStream decodes a compressed file on SFML's streaming thread, one buffer of the given length at a time
+class MusicStream : public sf::SoundStream {
+    sf::InputSoundFile file;
+    std::vector<sf::Int16> samples;
+    bool lowered;
+
+    virtual bool onGetData(Chunk& data) override;
+    virtual void onSeek(sf::Time timeOffset) override;
+
+public:
+    MusicStream();
+    ~MusicStream();
+    bool open(const std::string& fp, sf::Time bufferLength);
+};
+
+MusicStream::MusicStream() :
+    lowered(false)
+{}
+
+MusicStream::~MusicStream() {
+    stop();
+}
+
+bool MusicStream::open(const std::string& fp, sf::Time bufferLength) {
+    if (!file.openFromFile(fp))
+        return false;
+
+    samples.resize((std::size_t)(bufferLength.asSeconds() * file.getSampleRate()) * file.getChannelCount());
+    initialize(file.getChannelCount(), file.getSampleRate());
+
+    return true;
+}
+
+bool MusicStream::onGetData(Chunk& data) {
+    //Decoding is background work, the streaming thread drops its priority the first time it runs
+    if (!lowered) {
+#ifdef _WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+        setpriority(PRIO_PROCESS, 0, 10);
+#endif
+        lowered = true;
+    }
+
+    sf::Uint64 count = file.read(samples.data(), samples.size());
+
+    //Loops by wrapping around inside the same buffer so there is never a gap at the seam
+    if (count < samples.size()) {
+        file.seek(0);
+        count += file.read(samples.data() + count, samples.size() - count);
+    }
+
+    data.samples = samples.data();
+    data.sampleCount = (std::size_t)count;
+
+    return count > 0;
+}
+
+void MusicStream::onSeek(sf::Time timeOffset) {
+    file.seek(timeOffset);
+}
+
+//Audio loads every effect at startup and plays them through a fixed pool of voices, so triggering one is never I/O
+class Audio {
+public:
+    enum SFX {
+        Move,
+        Capture,
+        Success,
+        Fail,
+        Count
+    };
+
+private:
+    MusicStream music;
+    sf::SoundBuffer buffers[Count];
+    sf::Sound voices[VOICES];
+    bool loaded[Count];
+    int next;
+
+public:
+    Audio();
+    void play(SFX s);
+};
+
+Audio::Audio() :
+    loaded(),
+    next(0) {
+    const char* paths[Count] = {
+        "./Assets/Audio/move.ogg",
+        "./Assets/Audio/capture.ogg",
+        "./Assets/Audio/success.ogg",
+        "./Assets/Audio/fail.ogg"
+    };
+
+    for (int i = 0; i < Count; i++)
+        loaded[i] = buffers[i].loadFromFile(paths[i]);
+
+    if (music.open(MUSICPATH, sf::seconds(MUSICBUFFER)))
+        music.play();
+}
+
+//Takes the next idle voice, or steals the one that started longest ago when all of them are busy
+void Audio::play(SFX s) {
+    if (!loaded[s])
+        return;
+
+    int voice = next;
+
+    for (int i = 0; i < VOICES; i++) {
+        if (voices[(next + i) % VOICES].getStatus() != sf::Sound::Playing) {
+            voice = (next + i) % VOICES;
+            break;
+        }
+    }
+
+    voices[voice].stop();
+    voices[voice].setBuffer(buffers[s]);
+    voices[voice].play();
+    next = (voice + 1) % VOICES;
+}
+
+//RaceClient is the game's end of a race. Answers are judged locally straight away and each prediction
+//is settled when the server's verdict for it arrives, the server's solved count always wins
+class RaceClient {
+    sf::TcpSocket socket;
+    sf::Packet packet;
+    sf::Uint32 sequence;
+    std::vector<bool> predictions;
+
+public:
+    bool connected;
+    bool started;
+    std::vector<sf::Uint32> puzzles;
+    int confirmed;
+    int mispredicted;
+    int racers;
+    int leader;
+
+    RaceClient();
+    bool join(const std::string& host, unsigned short port, sf::Uint32 player);
+    void answer(int slot, Chess::Move move, bool predicted);
+    void poll();
+    int solved() const;
+};
+
+RaceClient::RaceClient() :
+    sequence(0),
+    connected(false),
+    started(false),
+    confirmed(0),
+    mispredicted(0),
+    racers(0),
+    leader(0)
+{}
+
+bool RaceClient::join(const std::string& host, unsigned short port, sf::Uint32 player) {
+    if (socket.connect(host, port, sf::seconds(5.f)) != sf::Socket::Done)
+        return false;
+
+    packet.clear();
+    Protocol::join(packet, sequence++, player);
+    connected = socket.send(packet) == sf::Socket::Done;
+    socket.setBlocking(false);
+    return connected;
+}
+
+void RaceClient::answer(int slot, Chess::Move move, bool predicted) {
+    packet.clear();
+    Protocol::answer(packet, sequence++, (sf::Uint16)slot, Chess::uci(move));
+    socket.setBlocking(true);
+    socket.send(packet);
+    socket.setBlocking(false);
+    predictions.push_back(predicted);
+}
+
+//Drains whatever the server sent since the last frame without ever blocking
+void RaceClient::poll() {
+    sf::Socket::Status status;
+
+    while (connected && (status = socket.receive(packet)) == sf::Socket::Done) {
+        sf::Uint8 op;
+        sf::Uint32 number;
+        packet >> op;
+
+        if (op == Protocol::Start) {
+            sf::Uint16 length;
+            packet >> number >> length;
+            puzzles.resize(length);
+
+            for (sf::Uint16 i = 0; i < length; i++)
+                packet >> puzzles[i];
+
+            started = true;
+        }
+        else if (op == Protocol::Verdict && !predictions.empty()) {
+            sf::Uint16 slot, count;
+            sf::Uint8 correct;
+            packet >> number >> slot >> correct >> count;
+
+            if ((correct != 0) != predictions.front())
+                mispredicted++;
+
+            predictions.erase(predictions.begin());
+            confirmed = count;
+        }
+        else if (op == Protocol::Progress) {
+            sf::Uint16 total;
+            sf::Uint8 n;
+            sf::Uint32 player;
+            sf::Uint16 count = 0, slot;
+            packet >> total >> n;
+
+            if (n > 0)
+                packet >> player >> count >> slot;
+
+            racers = total;
+            leader = count;
+        }
+    }
+
+    if (connected && (status == sf::Socket::Disconnected || status == sf::Socket::Error))
+        connected = false;
+}
+
+int RaceClient::solved() const {
+    return confirmed + (int)std::count(predictions.begin(), predictions.end(), true);
+}
+
 class Game {
     Engine& engine;
     std::vector<Actor*> actors;
     sf::RectangleShape bar;
     Board* board;
     PlayButton* playButton;
-    sf::Music music;
+    HudText* scoreText;
+    HudText* timerText;
+    HudText* levelText;
+    HudText* raceText;
+    Particles* particles;
+    Audio audio;
+    ScoreStore scores;
+    PuzzlePack pack;
+    RaceClient race;
+    HintCache hints;
+    RatingStore ratings;
+    PuzzleFeed feed;
+    std::vector<bool> picked;
 
     int kept;
     float timer;
     bool countdown;
     int level;
-    int correct[2];
+    const Puzzle* puzzle;
+    std::size_t puzzleIndex;
+    PreparedPuzzle prepared;
+    Chess::Position current;
+    int node;
+    int played;
+    bool finished;
+    bool answered;
+    int hintStage;
+    int mistakes;
+
+    Chess::Move selectedMove() const;
+    Chess::Move hintMove() const;
+    void showHint();
+    void loadPuzzle();
+    std::size_t choosePuzzle();
+    void prefetch();
 
 public:
     Game();
@@ -478,35 +2131,178 @@ public:
     //void loadPieces(Board* b, int arr[64]);
     void insertActor(Actor* a);
     void clearActors();
+    bool joinRace(const std::string& host, sf::Uint32 player);
     void play();
 };
 
+//The levels the game shipped with before they moved into PUZZLEPATH, played when that pack is missing or empty
+const char* const BUILTINLEVELS[] = {
+    "1k6/6R1/1K6/8/8/8/8/8 w - - bm Rg8#; dm 1; id \"level1\";",
+    "8/5B2/2r5/5R1p/6pk/8/6K1/8 w - - bm Rxh5#; dm 1; id \"level2\";",
+    "4bk2/ppp3p1/2np1N1p/2b5/2B2Bnq/8/PP4PP/4RR1K w - - bm Nh7# Rxe8#; dm 1; id \"level3\";",
+    "2k5/2P5/p1K5/1P6/8/8/8/8 w - - bm b6; dm 2; id \"level4\"; pv b6 a5 b7#;",
+    "2k5/2P5/1PK5/p7/8/8/8/8 w - - bm b7#; dm 1; id \"level5\";"
+};
+
 Game::Game() :
     engine(Engine::instance()),
     kept(0),
     timer(0),
     countdown(true),
-    bar(sf::Vector2f(1920, 24)),
+    bar(sf::Vector2f(Layout::WIDTH, 24)),
     board(new Board),
     playButton(new PlayButton),
+    scoreText(nullptr),
+    timerText(nullptr),
+    levelText(nullptr),
+    raceText(nullptr),
+    particles(new Particles(PARTICLES)),
+    scores(SAVEPATH),
+    hints(SAVEPATH),
+    ratings(SAVEPATH),
+    feed(pack),
     level(-1),
-    correct() {
+    puzzle(nullptr),
+    puzzleIndex(0),
+    node(0),
+    played(0),
+    finished(false),
+    answered(false),
+    hintStage(0),
+    mistakes(0) {
+    FontRegistry::instance().warm(FONTPATH, 64, "0123456789");
+    FontRegistry::instance().warm(FONTPATH, 48, "0123456789Level ");
+    scoreText = new HudText("%d", 64, engine.layout.score);
+    timerText = new HudText("%d", 64, engine.layout.timer);
+    levelText = new HudText("Level %d", 48, engine.layout.level);
+    raceText = new HudText("Lead %d", 48, engine.layout.race);
+
+    if (!pack.load(PUZZLEPATH) || pack.size() == 0) {
+        printf("no puzzles in %s, playing the built-in levels\n", PUZZLEPATH);
+        Puzzle puzzle;
+
+        for (const char* line : BUILTINLEVELS)
+            if (PuzzlePack::parse(line, puzzle))
+                pack.puzzles.push_back(puzzle);
+    }
+
+    ratings.load(pack);
+    picked.assign(pack.size(), false);
     bar.setFillColor(sf::Color::Red);
-    bar.setPosition(0, 1056);
-    if (music.openFromFile("./Assets/Audio/the-final-game.wav"))
-        music.play();
+    bar.setPosition(engine.layout.bar);
+}
+
+Game::~Game() {
+    actors.clear();
+}
+
+void Game::insertActor(Actor* a) {
+    actors.push_back(a);
+}
+
+//Actors created for a level are deleted with it, the ones Game keeps across levels are only unlisted
+void Game::clearActors() {
+    for (Actor* a : actors)
+        if (a != board && a != playButton && a != scoreText && a != timerText && a != levelText && a != raceText && a != particles)
+            delete a;
+
+    actors.clear();
+}
+
+//The player's two selections as a legal move of the position on the board, promotions become queens
+Chess::Move Game::selectedMove() const {
+    Chess::Position position = current;
+    Chess::MoveList list;
+    position.generate(list);
+
+    for (int i = 0; i < list.size; i++)
+        if (Chess::fromOf(list.moves[i]) == board->selection[0] && Chess::toOf(list.moves[i]) == board->selection[1])
+            return list.moves[i];
+
+    return Chess::NO_MOVE;
+}
+
+//The first analysed line the puzzle accepts, the bm move when the analysis is not there yet. Further into a line the
+//solution tree already knows the answer
+Chess::Move Game::hintMove() const {
+    Hint hint;
+
+    if (played > 0)
+        return puzzle->expected(node);
+
+    if (hints.lookup(*puzzle, hint))
+        for (Chess::Move m : hint.moves)
+            if (puzzle->accepts(m))
+                return m;
+
+    if (!puzzle->best.empty())
+        return puzzle->best[0];
+
+    return hint.moves.empty() ? Chess::NO_MOVE : hint.moves[0];
+}
+
+//Each press shows one more step of the hint, first the piece to move and then its target. Races get no hints
+void Game::showHint() {
+    if (puzzle == nullptr || level <= 0 || finished || race.connected || hintStage >= 2)
+        return;
+
+    Chess::Move m = hintMove();
+
+    if (m == Chess::NO_MOVE)
+        return;
+
+    board->showHint(hintStage, hintStage == 0 ? Chess::fromOf(m) : Chess::toOf(m));
+    hintStage++;
+}
+
+//The puzzle not yet picked that is rated nearest to the player, aimed a little above or below so the same rating does
+//not always lead to the same puzzle. Once the whole pack has been picked it starts over, minus the puzzles in play
+std::size_t Game::choosePuzzle() {
+    float target = ratings.player(PLAYER).rating + (float)(rand() % (2 * (int)RATINGSPREAD + 1)) - RATINGSPREAD;
+    std::uint32_t next;
+
+    if (!ratings.next(target, [&](std::uint32_t i) { return picked[i]; }, next)) {
+        for (std::size_t i = 0; i < pack.size(); i++)
+            picked[i] = (puzzle != nullptr && i == puzzleIndex) || feed.queued(i);
+
+        if (!ratings.next(target, [&](std::uint32_t i) { return picked[i]; }, next))
+            return puzzleIndex;
+    }
+
+    picked[next] = true;
+    return next;
 }
 
-Game::~Game() {
-    actors.clear();
+//Keeps PREFETCH puzzles picked ahead and being prepared, their analysis queued for hints behind them. The picks use
+//the rating as it stands, so a change in strength shows a few levels later
+void Game::prefetch() {
+    while (pack.size() > 0 && feed.size() < PREFETCH) {
+        std::size_t next = choosePuzzle();
+        feed.request(next);
+        hints.request(pack.puzzles[next]);
+    }
 }
 
-void Game::insertActor(Actor* a) {
-    actors.push_back(a);
+void Game::loadPuzzle() {
+    Game::insertActor(new Background);
+    Game::insertActor(board);
+
+    for (const std::pair<Chess::Square, Chess::Piece>& p : prepared.pieces)
+        Game::insertActor(new Piece(*board, p.second, p.first));
+
+    Game::insertActor(scoreText);
+    Game::insertActor(timerText);
+    Game::insertActor(levelText);
+
+    if (race.connected)
+        Game::insertActor(raceText);
+
+    Game::insertActor(particles);
+    Game::insertActor(new Cursor);
 }
 
-void Game::clearActors() {
-    actors.clear();
+bool Game::joinRace(const std::string& host, sf::Uint32 player) {
+    return pack.size() > 0 && race.join(host, SERVERPORT, player);
 }
 
 void Game::play() {
@@ -514,39 +2310,92 @@ void Game::play() {
         sf::Event& event = Engine::instance().next();
         static float wait = 1.f;
 
-        if (board->selection[0] > 0) {
-            board->line[0].setFillColor(sf::Color::Yellow);
-        }
+        board->line[0].setFillColor(board->selection[0] != Chess::NO_SQUARE ? sf::Color::Yellow : sf::Color::Transparent);
+        board->line[1].setFillColor(board->selection[1] != Chess::NO_SQUARE ? sf::Color::Green : sf::Color::Transparent);
 
-        if (board->selection[1] > 0) {
-            board->line[1].setFillColor(sf::Color::Green);
-        }
+        race.poll();
+
+        //A race takes the first answer for each puzzle, right or wrong, and moves on without waiting for the server.
+        //Alone, a correct move that does not end the puzzle is answered by the opponent and the line goes on
+        if (board->moved && puzzle != nullptr && !finished) {
+            Chess::Move move = selectedMove();
+            PuzzleStep step = played == 0 ? prepared.step(move) : puzzle->step(node, current, move);
+            bool solved = step.correct && (step.solved || race.connected);
 
-        if (board->selection[0] > 0 && board->selection[1] > 0){
-            if (board->selection[0] == correct[0] && board->selection[1] == correct[1]) {
+            audio.play(board->pieceAt(board->selection[1]) != nullptr ? Audio::Capture : Audio::Move);
+            audio.play(step.correct ? Audio::Success : Audio::Fail);
+
+            if (race.connected && !answered)
+                race.answer(level - 1, move, step.correct);
+
+            answered = true;
+
+            if (!step.correct)
+                mistakes++;
+
+            if (step.correct) {
+                Chess::Undo undo;
+                board->playMove(move);
+                current.make(move, undo);
+                played++;
+                board->clearHint();
+                hintStage = 0;
+            }
+
+            if (solved) {
+                particles->burst(board->squarePosition(board->selection[1]) + sf::Vector2f(Board::TILESIZE / 2, Board::TILESIZE / 2), 600);
                 score += (int)timer;
-                timer = 0;
-                wait += engine.deltaTime;
+                scores.submit(PLAYER, (std::uint32_t)puzzleIndex, GAMELENGTH - timer, (int)timer, (std::int64_t)time(NULL));
             }
+            else if (step.correct && step.reply != Chess::NO_MOVE) {
+                Chess::Undo undo;
+                board->playMove(step.reply, MOVETIME + REPLYDELAY);
+                current.make(step.reply, undo);
+                node = step.node;
+            }
+
+            finished = solved || race.connected;
         }
 
-        if (level == 0 && playButton->value == 1) {
+        board->moved = false;
+
+        if (finished) {
+            timer = 0;
+            wait += engine.deltaTime;
+        }
+
+        if (level == 0 && playButton->value == 1 && (!race.connected || race.started)) {
             timer = 0;
         }
 
         if (timer <= 0 && wait >= 1.f) {
+            if (race.connected && level > 0 && !answered)
+                race.answer(level - 1, Chess::NO_MOVE, false);
+
+            //Every attempt rates the player against the puzzle, a solve only counts without a wrong move on the way
+            if (level > 0 && puzzle != nullptr)
+                ratings.record(PLAYER, (std::uint32_t)puzzleIndex, finished && mistakes == 0, (std::int64_t)time(NULL));
+
             board->line[0].setFillColor(sf::Color::Transparent);
             board->line[1].setFillColor(sf::Color::Transparent);
             clearActors();
+            engine.tweens.clear();
 
             level++;
 
             if (level != 0) {
                 timer = GAMELENGTH;
                 wait = 0.f;
-
-                board->selection[0] = 0;
-                board->selection[1] = 0;
+                finished = false;
+                answered = false;
+
+                board->clearSelection();
+                board->clearPieces();
+                board->clearHint();
+                hintStage = 0;
+                node = 0;
+                played = 0;
+                mistakes = 0;
             }
 
             switch (level) {
@@ -557,86 +2406,34 @@ void Game::play() {
                 Game::insertActor(new Title);
                 Game::insertActor(playButton);
                 Game::insertActor(new Cursor);
-                break;
-            case 1:
-                correct[0] = 702; correct[1] = 701;
-                Game::insertActor(new Background);
-                Game::insertActor(board);
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackKing, 2, 1));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteRook, 7, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteKing, 2, 3));
-                Game::insertActor(new Score);
-                Game::insertActor(new Cursor);
-                break;
-            case 2:
-                correct[0] = 604; correct[1] = 804;
-                Game::insertActor(new Background);
-                Game::insertActor(board);
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteBishop, 6, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackRook, 3, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteRook, 6, 4));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 8, 4));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 7, 5));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackKing, 8, 5));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteKing, 7, 7));
-                Game::insertActor(new Score);
-                Game::insertActor(new Cursor);
-                break;
-            case 3:
-                correct[0] = 605; correct[1] = 403;
-                Game::insertActor(new Background);
-                Game::insertActor(board);
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackBishop, 5, 1));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackKing, 6, 1));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 1, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 2, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 3, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 7, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackKnight, 3, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 4, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 8, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackBishop, 3, 4));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteBishop, 3, 5));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteBishop, 6, 5));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackKnight, 7, 5));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackQueen, 8, 5));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteKnight, 6, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 1, 7));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 2, 7));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 7, 7));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 8, 7));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteRook, 5, 8));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteRook, 6, 8));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteKing, 8, 8));
-                Game::insertActor(new Score);
-                Game::insertActor(new Cursor);
-                break;
-            case 4:
-                correct[0] = 204; correct[1] = 203;
-                Game::insertActor(new Background);
-                Game::insertActor(board);
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackKing, 3, 1));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 3, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 1, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteKing, 3, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 2, 4));
-                Game::insertActor(new Score);
-                Game::insertActor(new Cursor);
-                break;
-            case 5:
-                correct[0] = 203; correct[1] = 202;
-                Game::insertActor(new Background);
-                Game::insertActor(board);
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackKing, 3, 1));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 3, 2));
-                Game::insertActor(new Piece(*board, Piece::PIECE::BlackPawn, 1, 4));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhiteKing, 3, 3));
-                Game::insertActor(new Piece(*board, Piece::PIECE::WhitePawn, 2, 3));
-                Game::insertActor(new Score);
-                Game::insertActor(new Cursor);
+
+                if (!race.connected)
+                    prefetch();
                 break;
             default:
-            Engine::instance().window.close();
+                //A race ends with the server's list. Alone the levels never run out, each one comes prepared from the
+                //feed and the next pick takes its place
+                if (pack.size() == 0 || (race.connected && level > (int)race.puzzles.size())) {
+                    Engine::instance().window.close();
+                    break;
+                }
+
+                if (race.connected) {
+                    PuzzleFeed::prepare(pack.puzzles[race.puzzles[level - 1] % pack.size()], prepared);
+                    prepared.index = race.puzzles[level - 1] % pack.size();
+                }
+                else if (!feed.take(prepared)) {
+                    prefetch();
+                    feed.take(prepared);
+                }
+
+                puzzleIndex = prepared.index;
+                puzzle = prepared.puzzle;
+                current = puzzle->position;
+                loadPuzzle();
+
+                if (!race.connected)
+                    prefetch();
                 break;
             }
         }
@@ -646,26 +2443,911 @@ void Game::play() {
         case sf::Event::Closed:
             Engine::instance().window.close();
             break;
+        case sf::Event::KeyPressed:
+            if (event.key.code == sf::Keyboard::H)
+                showHint();
+            break;
         default:
             break;
         }
 
+#ifdef _DEBUG
+        unsigned long long allocations = Diagnostics::allocations;
+#endif
+
+        if (level > 0) {
+            scoreText->set(race.connected ? race.solved() : score);
+            raceText->set(race.leader);
+            timerText->set(timer > 0.f ? (int)std::ceil(timer) : 0);
+            levelText->set(level);
+        }
+
+#ifdef _DEBUG
+        unsigned long long hudAllocations = Diagnostics::allocations - allocations;
+#endif
+
+        engine.tweens.update(engine.deltaTime);
+        engine.world.update(engine.deltaTime, engine.getMousePosition());
+
         for (Actor* a : actors)
             a->execute();
 
         if (countdown) {
             timer -= engine.deltaTime;
-            Engine::instance().window.draw(bar);
+            engine.render(bar, LayerHud);
         }
 
         bar.setScale(sf::Vector2f((float)(timer / GAMELENGTH), 1.f));
-        Engine::instance().window.display();
+        engine.present();
+
+#ifdef _DEBUG
+        Diagnostics::report(Diagnostics::allocations - allocations, hudAllocations);
+#endif
+    }
+}
+
+//Micro benchmarks run headless, "Game --bench tweens"
+namespace Bench {
+    int tweens() {
+        const int COUNT = 10000;
+        const int FRAMES = 600;
+        World world;
+        Tweens tweens(world);
+        sf::Clock clock;
+        sf::Int64 total = 0;
+        std::size_t next = 0;
+
+        for (int i = 0; i < COUNT; i++)
+            world.create(LayerPieces);
+
+        for (int frame = 0; frame < FRAMES; frame++) {
+            while (tweens.size() < COUNT) {
+                sf::Vector2f a((float)(rand() % 1920), (float)(rand() % 1080));
+                sf::Vector2f b((float)(rand() % 1920), (float)(rand() % 1080));
+                tweens.add((Entity)(next++ % COUNT), a, b, 0.5f + (rand() % 100) / 50.f, (Tweens::EASING)(rand() % 4));
+            }
+
+            clock.restart();
+            tweens.update(1.f / 60.f);
+            total += clock.getElapsedTime().asMicroseconds();
+        }
+
+        printf("%d tweens: %.1f us per frame over %d frames\n", COUNT, (double)total / FRAMES, FRAMES);
+        return 0;
+    }
+
+    sf::Vector2f legacyNormalize(sf::Vector2f v) {
+        float l = std::sqrt(std::pow(v.x, 2) + std::pow(v.y, 2));
+
+        return l == 0 ? sf::Vector2f() : sf::Vector2f(v.x / l, v.y / l);
+    }
+
+    float legacyDistanceBetween(sf::Vector2f a, sf::Vector2f b) {
+        return sqrt(pow(b.x - a.x, 2) + pow(b.y - a.y, 2) * 1.f);
+    }
+
+    sf::Vector2f legacyLinearInterpolate(sf::Vector2f a, sf::Vector2f b, float t) {
+        return sf::Vector2f(a + sf::Vector2f(t * (b - a).x, t * (b - a).y));
+    }
+
+    void report(const char* name, sf::Int64 legacy, sf::Int64 batched, std::size_t elements) {
+        printf("%-10s legacy %6.2f ns  batched %6.2f ns  (%.1fx)\n", name,
+            legacy * 1000.0 / elements, batched * 1000.0 / elements, (double)legacy / std::max<sf::Int64>(batched, 1));
+    }
+
+    //Compares the original pow based helpers with the batched kernels over the same arrays
+    int math() {
+        const std::size_t COUNT = 1 << 16;
+        const int REPEAT = 200;
+        std::vector<sf::Vector2f> a(COUNT), b(COUNT), out(COUNT);
+        std::vector<float> t(COUNT), distances(COUNT);
+        sf::Clock clock;
+        float sink = 0.f;
+
+        for (std::size_t i = 0; i < COUNT; i++) {
+            a[i] = sf::Vector2f((float)(rand() % 2000 - 1000), (float)(rand() % 2000 - 1000));
+            b[i] = sf::Vector2f((float)(rand() % 2000 - 1000), (float)(rand() % 2000 - 1000));
+            t[i] = (rand() % 1000) / 1000.f;
+        }
+
+        clock.restart();
+        for (int r = 0; r < REPEAT; r++) {
+            for (std::size_t i = 0; i < COUNT; i++)
+                out[i] = legacyNormalize(a[i]);
+            sink += out[r].x;
+        }
+        sf::Int64 legacy = clock.restart().asMicroseconds();
+        for (int r = 0; r < REPEAT; r++) {
+            Utilities::normalize(a.data(), out.data(), COUNT);
+            sink += out[r].x;
+        }
+        report("normalize", legacy, clock.restart().asMicroseconds(), COUNT * REPEAT);
+
+        for (int r = 0; r < REPEAT; r++) {
+            for (std::size_t i = 0; i < COUNT; i++)
+                distances[i] = legacyDistanceBetween(a[i], b[i]);
+            sink += distances[r];
+        }
+        legacy = clock.restart().asMicroseconds();
+        for (int r = 0; r < REPEAT; r++) {
+            Utilities::distance(a.data(), b.data(), distances.data(), COUNT);
+            sink += distances[r];
+        }
+        report("distance", legacy, clock.restart().asMicroseconds(), COUNT * REPEAT);
+
+        for (int r = 0; r < REPEAT; r++) {
+            for (std::size_t i = 0; i < COUNT; i++)
+                out[i] = legacyLinearInterpolate(a[i], b[i], t[i]);
+            sink += out[r].x;
+        }
+        legacy = clock.restart().asMicroseconds();
+        for (int r = 0; r < REPEAT; r++) {
+            Utilities::lerp(a.data(), b.data(), t.data(), out.data(), COUNT);
+            sink += out[r].x;
+        }
+        report("lerp", legacy, clock.restart().asMicroseconds(), COUNT * REPEAT);
+
+        return sink == 0.5f ? 1 : 0;
+    }
+
+    //Full pool of confetti, times the update kernels plus the vertex build per frame
+    int particles() {
+        const int COUNT = 50000;
+        const int FRAMES = 600;
+        ParticlePool pool(COUNT);
+        sf::VertexArray vertices;
+        sf::Clock clock;
+        sf::Int64 update = 0;
+        sf::Int64 build = 0;
+
+        for (int frame = 0; frame < FRAMES; frame++) {
+            pool.burst(sf::Vector2f(960.f, 540.f), COUNT - (int)pool.size());
+
+            clock.restart();
+            pool.update(1.f / 60.f);
+            update += clock.restart().asMicroseconds();
+            pool.build(vertices, 8.f);
+            build += clock.restart().asMicroseconds();
+        }
+
+        printf("%d particles: update %.1f us, build %.1f us per frame over %d frames\n", COUNT,
+            (double)update / FRAMES, (double)build / FRAMES, FRAMES);
+        return 0;
+    }
+
+    class LegacyActor {
+    public:
+        virtual ~LegacyActor() {}
+        virtual void execute(sf::RenderTarget& target, float dt) = 0;
+    };
+
+    class LegacySprite : public LegacyActor {
+        sf::Sprite sprite;
+        sf::Vector2f velocity;
+
+    public:
+        LegacySprite(const sf::Texture& texture, sf::Vector2f p, sf::Vector2f v) : sprite(texture), velocity(v) {
+            sprite.setPosition(p);
+        }
+
+        void execute(sf::RenderTarget& target, float dt) override {
+            sprite.move(velocity * dt);
+            target.draw(sprite);
+        }
+    };
+
+    //Update plus draw submission for heap actors behind virtual calls against the same sprites in the World
+    int actors() {
+        const int FRAMES = 60;
+        const int COUNTS[] = { 1000, 100000 };
+        sf::RenderTexture target;
+        RenderQueue queue;
+        sf::Image image;
+        sf::Texture texture;
+
+        target.create(1920, 1080);
+        image.create(32, 32, sf::Color::White);
+        texture.loadFromImage(image);
+
+        for (int count : COUNTS) {
+            std::vector<LegacyActor*> legacy;
+            World world;
+            sf::Clock clock;
+            sf::Int64 legacyTime = 0;
+            sf::Int64 worldTime = 0;
+
+            for (int i = 0; i < count; i++) {
+                sf::Vector2f p((float)(rand() % 1920), (float)(rand() % 1080));
+                sf::Vector2f v((float)(rand() % 200 - 100), (float)(rand() % 200 - 100));
+                Entity e = world.create(LayerPieces);
+
+                legacy.push_back(new LegacySprite(texture, p, v));
+                world.setTexture(e, &texture, sf::IntRect());
+                world.setPosition(e, p);
+                world.setVelocity(e, v);
+                world.setBehavior(e, World::Drift);
+                world.show(e, true);
+            }
+
+            for (int frame = 0; frame < FRAMES; frame++) {
+                target.clear();
+                clock.restart();
+                for (LegacyActor* a : legacy)
+                    a->execute(target, 1.f / 60.f);
+                legacyTime += clock.restart().asMicroseconds();
+                target.display();
+
+                target.clear();
+                clock.restart();
+                world.update(1.f / 60.f, sf::Vector2f());
+                world.render(queue);
+                queue.submit(target);
+                worldTime += clock.restart().asMicroseconds();
+                target.display();
+            }
+
+            printf("%d entities: actors %.1f us in %d draw calls, world %.1f us in %u draw calls per frame\n", count,
+                (double)legacyTime / FRAMES, count, (double)worldTime / FRAMES, queue.drawCalls);
+
+            for (LegacyActor* a : legacy)
+                delete a;
+        }
+
+        return 0;
+    }
+
+    std::uint64_t divide(Chess::Position& position, int depth) {
+        Chess::MoveList list;
+        position.generate(list);
+
+        if (depth == 1)
+            return list.size;
+
+        std::uint64_t nodes = 0;
+        Chess::Undo undo;
+
+        for (int i = 0; i < list.size; i++) {
+            position.make(list.moves[i], undo);
+            nodes += divide(position, depth - 1);
+            position.unmake(list.moves[i], undo);
+        }
+
+        return nodes;
+    }
+
+    //Move generator node counts against the published perft results
+    int perft() {
+        struct Case { const char* fen; int depth; std::uint64_t nodes; };
+        const Case CASES[] = {
+            { Chess::STARTFEN, 5, 4865609 },
+            { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+            { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624 },
+        };
+        int failures = 0;
+
+        for (const Case& c : CASES) {
+            Chess::Position position;
+            position.fromFen(c.fen);
+            sf::Clock clock;
+            std::uint64_t nodes = divide(position, c.depth);
+            float seconds = std::max(clock.getElapsedTime().asSeconds(), 1e-6f);
+
+            printf("depth %d %llu nodes (%s) %.1f Mnps  %s\n", c.depth, (unsigned long long)nodes,
+                nodes == c.nodes ? "ok" : "MISMATCH", nodes / seconds / 1e6f, c.fen);
+            failures += nodes != c.nodes;
+        }
+
+        return failures == 0 ? 0 : 1;
+    }
+
+    //Random games from the start and the tactics positions, replayed once per way of evaluating every position on the
+    //way: material and squares summed from scratch or read from the position's running sums, and the network's
+    //accumulator rebuilt at every position or updated from the one before. Each pair has to agree everywhere, and each
+    //way keeps its best of three rounds. Without a weights file the network is random, which times the kernels just as well
+    int eval() {
+        const char* NAMES[5] = { "make only", "classical, from scratch", "classical, incremental", "network, refreshed", "network, incremental" };
+        const int length = 80;
+        PuzzlePack suite;
+        std::vector<Chess::Position> starts(1);
+        std::vector<std::vector<Chess::Move>> games;
+
+        suite.load(TACTICSPATH);
+
+        for (const Puzzle& puzzle : suite.puzzles)
+            starts.push_back(puzzle.position);
+
+        srand(1);
+
+        for (int g = 0; g < 4000; g++) {
+            Chess::Position position = starts[g % starts.size()];
+            std::vector<Chess::Move> moves;
+            Chess::Undo undo;
+
+            for (int ply = 0; ply < length; ply++) {
+                Chess::MoveList list;
+                position.generate(list);
+
+                if (list.size == 0)
+                    break;
+
+                moves.push_back(list.moves[rand() % list.size]);
+                position.make(moves.back(), undo);
+            }
+
+            games.push_back(moves);
+        }
+
+        auto classical = [](const Chess::Position& position) {
+            int middlegame = 0, endgame = 0, phase = 0;
+
+            for (Chess::Bitboard b = position.pieces(); b; b &= b - 1) {
+                Chess::Square s = Chess::lsb(b);
+                Chess::Piece p = position.pieceOn(s);
+                middlegame += Chess::pieceSquare(p, s, Chess::Middlegame);
+                endgame += Chess::pieceSquare(p, s, Chess::Endgame);
+                phase += Chess::piecePhase(p);
+            }
+
+            phase = std::min(phase, Chess::PHASEMAX);
+            int score = (middlegame * phase + endgame * (Chess::PHASEMAX - phase)) / Chess::PHASEMAX;
+            return position.sideToMove() == Chess::White ? score : -score;
+        };
+
+        Chess::Network& network = Chess::Network::instance();
+        bool trained = network.loaded();
+
+        if (!trained)
+            network.randomize(1);
+
+        std::vector<Chess::Accumulator> stack(length + 1);
+        std::vector<int> reference;
+        float seconds[5] = { 1e9f, 1e9f, 1e9f, 1e9f, 1e9f };
+        long long checksum = 0;
+        std::size_t count = 0;
+        int mismatches = 0;
+
+        for (int round = 0; round < 3; round++) {
+            for (int pass = 0; pass < 5; pass++) {
+                sf::Clock clock;
+                count = 0;
+
+                for (std::size_t g = 0; g < games.size(); g++) {
+                    Chess::Position position = starts[g % starts.size()];
+                    Chess::Undo undo;
+
+                    if (pass == 4)
+                        network.refresh(position, stack[0]);
+
+                    for (std::size_t ply = 0; ply < games[g].size(); ply++) {
+                        position.make(games[g][ply], undo);
+                        int value = 0;
+
+                        if (pass == 1)
+                            value = classical(position);
+                        else if (pass == 2)
+                            value = Chess::evaluate(position);
+                        else if (pass == 3) {
+                            network.refresh(position, stack[ply + 1]);
+                            value = network.evaluate(stack[ply + 1], position.sideToMove());
+                        }
+                        else if (pass == 4) {
+                            network.update(stack[ply], position, stack[ply + 1]);
+                            value = network.evaluate(stack[ply + 1], position.sideToMove());
+                        }
+
+                        if (round == 0 && (pass == 1 || pass == 3))
+                            reference.push_back(value);
+                        else if (round == 0 && (pass == 2 || pass == 4))
+                            mismatches += reference[count] != value;
+
+                        checksum += value;
+                        count++;
+                    }
+                }
+
+                if (pass == 2)
+                    reference.clear();
+
+                seconds[pass] = std::min(seconds[pass], std::max(clock.getElapsedTime().asSeconds(), 1e-6f));
+            }
+        }
+
+        printf("%zu positions, %s network, %s kernels, checksum %lld\n", count, trained ? "trained" : "random", Chess::Network::kernels(), checksum);
+
+        //An evaluation that costs less than the timing noise of the replay is reported as such
+        for (int pass = 0; pass < 5; pass++) {
+            float beyond = seconds[pass] - seconds[0];
+            printf("%-24s %7.2f M positions/s", NAMES[pass], count / seconds[pass] / 1e6f);
+
+            if (pass > 0 && beyond > seconds[0] / 10)
+                printf(", %6.1f ns per evaluation beyond make, %7.2f M evaluations/s", beyond * 1e9f / count, count / beyond / 1e6f);
+            else if (pass > 0)
+                printf(", within the cost of make");
+
+            printf("\n");
+        }
+
+        if (mismatches > 0)
+            printf("%d evaluations differ between the incremental and the full computation\n", mismatches);
+
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    //Fixed-depth search against quiescence on the tactics suite. A puzzle counts as solved from the iteration where the
+    //best move becomes a solution and stays one up to TACTICSDEPTH, and the nodes spent until then are what we compare
+    int tactics() {
+        PuzzlePack suite;
+
+        if (!suite.load(TACTICSPATH) || suite.size() == 0) {
+            printf("no puzzles in %s\n", TACTICSPATH);
+            return 1;
+        }
+
+        for (int quiescence = 0; quiescence < 2; quiescence++) {
+            std::uint64_t total = 0;
+            std::uint64_t toSolution = 0;
+            int solved = 0;
+            sf::Clock clock;
+
+            for (const Puzzle& puzzle : suite.puzzles) {
+                Chess::Search search;
+                Chess::SearchLimits limits;
+                std::uint64_t settled = 0;
+                bool solving = false;
+
+                limits.depth = TACTICSDEPTH;
+                limits.quiescence = quiescence != 0;
+                limits.iteration = [&](const Chess::SearchResult& result) {
+                    bool accepted = puzzle.accepts(result.best);
+
+                    if (accepted && !solving)
+                        settled = result.nodes;
+
+                    solving = accepted;
+                };
+
+                total += search.run(puzzle.position, limits).nodes;
+
+                if (solving) {
+                    solved++;
+                    toSolution += settled;
+                }
+            }
+
+            float seconds = std::max(clock.getElapsedTime().asSeconds(), 1e-6f);
+
+            printf("%-10s solved %d/%zu, %llu nodes to the solutions, %llu nodes to depth %d, %.2f s, %.2f Mnps\n",
+                quiescence ? "quiescence" : "fixed", solved, suite.size(), (unsigned long long)toSolution,
+                (unsigned long long)total, TACTICSDEPTH, seconds, total / seconds / 1e6f);
+        }
+
+        return 0;
+    }
+
+    //Proof-number search against alpha-beta on the mate suite, both with the same node budget. The solver also lists
+    //every mating first move, alpha-beta only has to prove the mate score at the puzzle's dm depth
+    int mates() {
+        struct Row {
+            int puzzles;
+            int solved;
+            int proven;
+            std::uint64_t solverNodes;
+            std::uint64_t searchNodes;
+            float solverSeconds;
+            float searchSeconds;
+        };
+
+        PuzzlePack suite;
+        Chess::MateSolver solver;
+        Row rows[MAXMATE + 1] = {};
+        int wrong = 0;
+
+        if (!suite.load(MATESPATH) || suite.size() == 0) {
+            printf("no puzzles in %s\n", MATESPATH);
+            return 1;
+        }
+
+        for (const Puzzle& puzzle : suite.puzzles) {
+            int dm = atoi(puzzle.operation("dm").c_str());
+
+            if (dm < 1 || dm > MAXMATE)
+                continue;
+
+            Row& row = rows[dm];
+            sf::Clock clock;
+            Chess::MateResult mate = solver.solve(puzzle.position);
+            row.solverSeconds += clock.restart().asSeconds();
+
+            Chess::Search search;
+            Chess::SearchLimits limits;
+            limits.depth = 2 * dm - 1;
+            limits.nodes = MATEBUDGET;
+            Chess::SearchResult result = search.run(puzzle.position, limits);
+            row.searchSeconds += clock.restart().asSeconds();
+
+            row.puzzles++;
+            row.solved += mate.moves == dm;
+            row.proven += result.depth == 2 * dm - 1 && result.score == MATE - (2 * dm - 1);
+            row.solverNodes += mate.nodes;
+            row.searchNodes += result.nodes;
+
+            if (mate.moves != dm && !mate.exhausted) {
+                printf("%s: dm %d but the solver finds %d\n", puzzle.id.c_str(), dm, mate.moves);
+                wrong++;
+            }
+        }
+
+        for (int dm = 1; dm <= MAXMATE; dm++) {
+            const Row& row = rows[dm];
+
+            if (row.puzzles > 0)
+                printf("mate in %d, %2d puzzles: proof-number %2d solved, %9llu nodes, %6.2f s | alpha-beta %2d proven, %9llu nodes, %6.2f s\n",
+                    dm, row.puzzles, row.solved, (unsigned long long)row.solverNodes, row.solverSeconds,
+                    row.proven, (unsigned long long)row.searchNodes, row.searchSeconds);
+        }
+
+        return wrong == 0 ? 0 : 1;
+    }
+
+    //The endgames of the mates suite that the tablebases cover: the stored distance has to agree with dm, every bm move
+    //has to keep it, and alpha-beta is timed to the same mate with and without probing below the root
+    int endgames() {
+        PuzzlePack suite;
+        int covered = 0;
+        int wrong = 0;
+        int proven[2] = {};
+        std::uint64_t nodes[2] = {};
+        float seconds[2] = {};
+
+        if (Chess::Tablebases::instance().pieces() <= 2) {
+            printf("no tablebases in %s, generate them with TbGen\n", TBPATH);
+            return 1;
+        }
+
+        if (!suite.load(MATESPATH) || suite.size() == 0) {
+            printf("no puzzles in %s\n", MATESPATH);
+            return 1;
+        }
+
+        for (const Puzzle& puzzle : suite.puzzles) {
+            int dm = atoi(puzzle.operation("dm").c_str());
+            Chess::TbResult stored;
+
+            if (dm < 1 || !Chess::Tablebases::instance().probe(puzzle.position, stored))
+                continue;
+
+            covered++;
+
+            if (stored.wdl != 1 || stored.plies != 2 * dm - 1) {
+                printf("%s: dm %d but the tablebase has %d plies\n", puzzle.id.c_str(), dm, stored.plies);
+                wrong++;
+            }
+
+            for (Chess::Move m : puzzle.best) {
+                Puzzle other = puzzle;
+                other.best.clear();
+                other.solution.clear();
+
+                if (!other.accepts(m)) {
+                    printf("%s: the tablebase turns down %s\n", puzzle.id.c_str(), Chess::uci(m).c_str());
+                    wrong++;
+                }
+            }
+
+            for (int probing = 0; probing < 2; probing++) {
+                Chess::Search search;
+                Chess::SearchLimits limits;
+                limits.depth = 2 * dm - 1;
+                limits.nodes = MATEBUDGET;
+                limits.tablebases = probing != 0;
+
+                sf::Clock clock;
+                Chess::SearchResult result = search.run(puzzle.position, limits);
+                seconds[probing] += clock.getElapsedTime().asSeconds();
+                nodes[probing] += result.nodes;
+
+                bool mate = result.score == MATE - (2 * dm - 1);
+                proven[probing] += mate;
+
+                if (probing && !mate) {
+                    printf("%s: alpha-beta misses the mate even with the tablebases\n", puzzle.id.c_str());
+                    wrong++;
+                }
+            }
+        }
+
+        printf("%d endgames covered: without tablebases %d proven, %llu nodes, %.2f s | with tablebases %d proven, %llu nodes, %.2f s\n",
+            covered, proven[0], (unsigned long long)nodes[0], seconds[0], proven[1], (unsigned long long)nodes[1], seconds[1]);
+        return wrong == 0 ? 0 : 1;
+    }
+
+    //Analyses the level pack into a scratch cache, then times the lookups a hint costs in game, first from the cache
+    //that did the analysis and then from a fresh one that only read the file
+    int hints() {
+        const std::string directory = SAVEPATH "/bench";
+        PuzzlePack pack;
+        int accepted = 0;
+        int found = 0;
+
+        if (!pack.load(PUZZLEPATH) || pack.size() == 0) {
+            printf("no puzzles in %s\n", PUZZLEPATH);
+            return 1;
+        }
+
+        std::remove((directory + "/hints.txt").c_str());
+        sf::Clock clock;
+
+        {
+            HintCache cache(directory);
+
+            for (const Puzzle& puzzle : pack.puzzles)
+                cache.request(puzzle);
+
+            cache.wait();
+        }
+
+        float analysis = clock.restart().asSeconds();
+        HintCache cache(directory);
+        const int rounds = 1000;
+
+        for (int r = 0; r < rounds; r++) {
+            for (const Puzzle& puzzle : pack.puzzles) {
+                Hint hint;
+
+                if (!cache.lookup(puzzle, hint))
+                    continue;
+
+                found++;
+
+                if (r == 0)
+                    accepted += std::any_of(hint.moves.begin(), hint.moves.end(), [&](Chess::Move m) { return puzzle.accepts(m); });
+            }
+        }
+
+        float lookups = clock.restart().asSeconds();
+        printf("%zu puzzles analysed in %.2f s, %d of %zu cached, %d with an accepted move among the top %d\n",
+            pack.size(), analysis, found / rounds, pack.size(), accepted, HINTLINES);
+        printf("lookup: %.2f us per hint\n", lookups * 1e6f / std::max(found, 1));
+        return found == rounds * (int)pack.size() ? 0 : 1;
+    }
+
+    //A million puzzles rated around 1500, then a simulated session that picks the unplayed puzzle nearest to the player
+    //and rates both after each attempt. Each pick and update should stay logarithmic in the pack size
+    int ratings() {
+        const std::uint32_t count = 1000000;
+        const int attempts = 100000;
+        std::vector<Rating> puzzles(count);
+        std::vector<bool> played(count, false);
+        PuzzleIndex index;
+        Rating player = { RATINGDEFAULT, DEVIATIONDEFAULT, 0 };
+        const float strength = 1900.f;
+        int solved = 0;
+
+        srand(1);
+
+        for (Rating& r : puzzles) {
+            r.rating = 600.f + (float)(rand() % 2000);
+            r.deviation = DEVIATIONDEFAULT;
+            r.timestamp = 0;
+        }
+
+        sf::Clock clock;
+        index.build(puzzles);
+        float build = clock.restart().asSeconds();
+
+        for (int i = 0; i < attempts; i++) {
+            float target = player.rating + (float)(rand() % (2 * (int)RATINGSPREAD + 1)) - RATINGSPREAD;
+            std::uint32_t next;
+
+            if (!index.nearest(target, [&](std::uint32_t p) { return played[p]; }, next))
+                break;
+
+            //A simulated player solves as often as the expected score of its real strength says
+            float chance = 1.f / (1.f + std::pow(10.f, (puzzles[next].rating - strength) / 400.f));
+            bool success = rand() % 1000 < (int)(chance * 1000.f);
+
+            played[next] = true;
+            solved += success;
+            Glicko::update(player, puzzles[next], success ? 1.f : 0.f, 1000 + i * 60);
+            index.update(next, puzzles[next].rating);
+        }
+
+        float session = clock.restart().asSeconds();
+        printf("%u puzzles indexed in %.2f s\n", count, build);
+        printf("%d attempts: %.2f us per pick and update, %d solved, player %.0f +- %.0f (strength %.0f)\n",
+            attempts, session * 1e6f / attempts, solved, player.rating, player.deviation, strength);
+        return std::fabs(player.rating - strength) < 3 * player.deviation + 50.f ? 0 : 1;
+    }
+
+    //Level transitions over the tactics and mate packs: preparing each puzzle when its level starts, against taking it
+    //from a feed kept PREFETCH puzzles ahead while the level before is played for a few frames
+    int feed() {
+        PuzzlePack pack;
+        PuzzlePack mates;
+
+        if (!pack.load(TACTICSPATH) || !mates.load(MATESPATH) || pack.size() + mates.size() == 0) {
+            printf("no puzzles in %s or %s\n", TACTICSPATH, MATESPATH);
+            return 1;
+        }
+
+        pack.puzzles.insert(pack.puzzles.end(), mates.puzzles.begin(), mates.puzzles.end());
+
+        sf::Clock clock;
+        float slowest[2] = { 0.f, 0.f };
+        float total[2] = { 0.f, 0.f };
+        PreparedPuzzle prepared;
+
+        for (const Puzzle& puzzle : pack.puzzles) {
+            clock.restart();
+            PuzzleFeed::prepare(puzzle, prepared);
+            float t = clock.getElapsedTime().asSeconds();
+            slowest[0] = std::max(slowest[0], t);
+            total[0] += t;
+        }
+
+        PuzzleFeed feed(pack);
+        std::size_t requested = 0;
+        int mismatched = 0;
+
+        while (requested < pack.size() && requested < PREFETCH)
+            feed.request(requested++);
+
+        for (std::size_t i = 0; i < pack.size(); i++) {
+            sf::sleep(sf::milliseconds(50));
+            clock.restart();
+
+            if (!feed.take(prepared) || prepared.index != i)
+                mismatched++;
+
+            float t = clock.getElapsedTime().asSeconds();
+            slowest[1] = std::max(slowest[1], t);
+            total[1] += t;
+
+            if (requested < pack.size())
+                feed.request(requested++);
+        }
+
+        printf("%zu puzzles, on the main thread: %.3f ms per transition, slowest %.3f ms\n",
+            pack.size(), total[0] * 1e3f / pack.size(), slowest[0] * 1e3f);
+        printf("from the feed: %.3f ms per transition, slowest %.3f ms\n", total[1] * 1e3f / pack.size(), slowest[1] * 1e3f);
+        return mismatched == 0 ? 0 : 1;
+    }
+
+    int run(const std::string& name) {
+        if (name == "tweens")
+            return tweens();
+        if (name == "math")
+            return math();
+        if (name == "particles")
+            return particles();
+        if (name == "actors")
+            return actors();
+        if (name == "perft")
+            return perft();
+        if (name == "tactics")
+            return tactics();
+        if (name == "mates")
+            return mates();
+        if (name == "endgames")
+            return endgames();
+        if (name == "hints")
+            return hints();
+        if (name == "ratings")
+            return ratings();
+        if (name == "feed")
+            return feed();
+        if (name == "eval")
+            return eval();
+
+        printf("unknown benchmark %s\n", name.c_str());
+        return 1;
+    }
+}
+
+//Proves every puzzle of a pack with the mate solver, writes the shortest mate as "dm" and checks the bm moves against
+//the full list of mating first moves. Longer mates also get a "pv" main line and "lines" for the other bm moves.
+//Puzzles the solver runs out of nodes on keep whatever they had
+int tagMates(const std::string& path) {
+    PuzzlePack pack;
+    Chess::MateSolver solver;
+    int tagged = 0;
+    int problems = 0;
+
+    if (!pack.load(path) || pack.size() == 0) {
+        printf("no puzzles in %s\n", path.c_str());
+        return 1;
+    }
+
+    for (Puzzle& puzzle : pack.puzzles) {
+        Chess::MateResult mate = solver.solve(puzzle.position);
+        Chess::Position position = puzzle.position;
+        std::string mating;
+
+        for (Chess::Move m : mate.mating)
+            mating += ' ' + position.san(m);
+
+        if (mate.moves == 0) {
+            if (mate.exhausted)
+                printf("%s: no mate found within %d nodes\n", puzzle.id.c_str(), MATEBUDGET);
+            else
+                puzzle.operations.erase("dm");
+
+            continue;
+        }
+
+        puzzle.operations["dm"] = std::to_string(mate.moves);
+        tagged++;
+        printf("%s: mate in %d,%s%s\n", puzzle.id.c_str(), mate.moves, mating.c_str(), mate.exhausted ? " (list cut short by the node budget)" : "");
+
+        //Longer mates get the main line the game plays out, starting from the first bm move when it mates, and a line
+        //for every other mating bm move so each of them leads on to the mate
+        if (mate.moves > 1) {
+            std::vector<Chess::Move> first;
+
+            for (Chess::Move m : puzzle.best)
+                if (std::find(mate.mating.begin(), mate.mating.end(), m) != mate.mating.end())
+                    first.push_back(m);
+
+            if (first.empty())
+                first.push_back(mate.mating[0]);
+
+            std::string lines;
+            puzzle.operations.erase("lines");
+
+            for (std::size_t i = 0; i < first.size(); i++) {
+                std::vector<Chess::Move> line = solver.line(puzzle.position, mate.moves, first[i]);
+                Chess::Position played = puzzle.position;
+                std::string text;
+
+                for (Chess::Move m : line) {
+                    Chess::Undo undo;
+                    text += (text.empty() ? "" : " ") + played.san(m);
+                    played.make(m, undo);
+                }
+
+                if (!played.checkmate())
+                    printf("%s: no full line for %s within %d nodes\n", puzzle.id.c_str(), position.san(first[i]).c_str(), MATEBUDGET);
+                else if (i == 0)
+                    puzzle.operations["pv"] = text;
+                else
+                    lines += (lines.empty() ? "" : ", ") + text;
+            }
+
+            if (!lines.empty())
+                puzzle.operations["lines"] = lines;
+        }
+
+        for (Chess::Move m : puzzle.best) {
+            if (std::find(mate.mating.begin(), mate.mating.end(), m) == mate.mating.end() && !mate.exhausted) {
+                printf("%s: bm %s does not mate in %d\n", puzzle.id.c_str(), position.san(m).c_str(), mate.moves);
+                problems++;
+            }
+        }
     }
+
+    //The tags are saved either way, a bm that does not mate fails the run so the pack is fixed before it ships
+    printf("%d of %zu puzzles are mates, %d bm moves disagree\n", tagged, pack.size(), problems);
+    return pack.save(path) && problems == 0 ? 0 : 1;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    Chess::Tablebases::instance().load(TBPATH);
+    Chess::Network::instance().load(NNUEPATH);
+
+    if (argc > 2 && std::string(argv[1]) == "--bench")
+        return Bench::run(argv[2]);
+
+    //Game --tag <pack.epd> tags the mate puzzles of a pack in place
+    if (argc > 2 && std::string(argv[1]) == "--tag")
+        return tagMates(argv[2]);
+
     Game g;
+
+    //Game --race <host> [player] joins a race on a leaderboard server instead of playing the levels alone
+    if (argc > 2 && std::string(argv[1]) == "--race" && !g.joinRace(argv[2], argc > 3 ? (sf::Uint32)atoi(argv[3]) : PLAYER))
+        printf("Could not join a race at %s, playing alone\n", argv[2]);
+
     g.play();
 }
 
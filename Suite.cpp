@@ -0,0 +1,349 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Puzzle.hpp"
+#include "Search.hpp"
+#include "Tablebase.hpp"
+
+#define SUITETIME 1000
+#define SUITEDEPTH (MAXPLY - 1)
+
+using namespace Chess;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    int threads;
+    long long time;
+    std::uint64_t nodes;
+    int depth;
+    std::size_t hash;
+    std::string input;
+    std::string json;
+};
+
+//A position counts as solved when the move the search ends on is one the puzzle accepts for bm and none of the am
+//moves. The solved fields tell when the search first settled on a right move for good, -1 when it never did
+struct Outcome {
+    Move played;
+    bool solved;
+    int depth;
+    std::uint64_t nodes;
+    long long ms;
+    int solvedDepth;
+    std::uint64_t solvedNodes;
+    long long solvedMs;
+};
+
+struct Entry {
+    Puzzle puzzle;
+    std::vector<Move> avoid;
+    Outcome outcome;
+};
+
+//Each worker has a stop flag and a deadline in milliseconds since the run began, -1 while it is idle. One clock
+//thread checks them every millisecond, the search itself only polls its flag. The lock keeps the clock's check and
+//its stop together, so a deadline that has just passed cannot stop the search the worker starts next
+struct Slot {
+    std::atomic<bool> stop;
+    long long deadline;
+    std::mutex mutex;
+};
+
+//bm is judged the way the game judges a player's move, so a mate other than the one written down counts too
+bool judge(const Entry& entry, Move m) {
+    const std::vector<Move>& avoid = entry.avoid;
+
+    return m != NO_MOVE && (entry.puzzle.best.empty() || entry.puzzle.accepts(m)) && std::find(avoid.begin(), avoid.end(), m) == avoid.end();
+}
+
+Outcome solve(const Entry& entry, Search& search, TranspositionTable& table, const Options& options, Slot& slot, Clock::time_point begin) {
+    Outcome outcome = { NO_MOVE, false, 0, 0, 0, -1, 0, -1 };
+    Clock::time_point start = Clock::now();
+
+    auto elapsed = [start] {
+        return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    };
+
+    table.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        slot.stop = false;
+        slot.deadline = options.time > 0 ? std::chrono::duration_cast<std::chrono::milliseconds>(start - begin).count() + options.time : -1;
+    }
+
+    SearchLimits limits;
+    limits.depth = options.depth;
+    limits.nodes = options.nodes;
+    limits.stop = &slot.stop;
+    limits.table = &table;
+    limits.iteration = [&](const SearchResult& r) {
+        if (!judge(entry, r.best))
+            outcome.solvedDepth = -1;
+        else if (outcome.solvedDepth < 0) {
+            outcome.solvedDepth = r.depth;
+            outcome.solvedNodes = r.nodes;
+            outcome.solvedMs = elapsed();
+        }
+    };
+
+    SearchResult result = search.run(entry.puzzle.position, limits);
+
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        slot.deadline = -1;
+    }
+
+    outcome.played = result.best;
+    outcome.solved = judge(entry, result.best);
+    outcome.depth = result.depth;
+    outcome.nodes = result.nodes;
+    outcome.ms = elapsed();
+
+    if (!outcome.solved) {
+        outcome.solvedDepth = -1;
+        outcome.solvedNodes = 0;
+        outcome.solvedMs = -1;
+    }
+
+    return outcome;
+}
+
+//Suites are small enough to read at once. Records without bm or am, or whose moves do not parse, are left out
+bool load(const std::string& path, std::vector<Entry>& entries, int& skipped) {
+    FILE* file = fopen(path.c_str(), "r");
+    char buffer[4096];
+    skipped = 0;
+
+    if (file == nullptr)
+        return false;
+
+    while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+        std::string line(buffer);
+
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+            line.pop_back();
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        Entry entry;
+        bool ok = PuzzlePack::parse(line, entry.puzzle);
+        std::istringstream avoid(ok ? entry.puzzle.operation("am") : "");
+        std::string san;
+
+        while (ok && avoid >> san) {
+            Move m = entry.puzzle.position.parseSan(san);
+            ok = m != NO_MOVE;
+            entry.avoid.push_back(m);
+        }
+
+        if (!ok || (entry.puzzle.best.empty() && entry.avoid.empty())) {
+            skipped++;
+            continue;
+        }
+
+        if (entry.puzzle.id.empty())
+            entry.puzzle.id = std::to_string(entries.size() + 1);
+
+        entries.push_back(entry);
+    }
+
+    fclose(file);
+    return true;
+}
+
+std::string quote(const std::string& text) {
+    std::string out = "\"";
+
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+
+        if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else {
+            out += c;
+        }
+    }
+
+    return out + "\"";
+}
+
+std::string sanList(Position position, const std::vector<Move>& moves) {
+    std::string out = "[";
+
+    for (std::size_t i = 0; i < moves.size(); i++)
+        out += (i > 0 ? ", " : "") + quote(position.san(moves[i]));
+
+    return out + "]";
+}
+
+//One object per run, settings first and the positions in file order, so runs of the same suite line up over time
+bool writeJson(const std::string& path, const Options& options, const std::vector<Entry>& entries, int solved, std::uint64_t nodes, double seconds) {
+    FILE* out = fopen(path.c_str(), "w");
+
+    if (out == nullptr)
+        return false;
+
+    fprintf(out, "{\n  \"suite\": %s,\n  \"threads\": %d,\n  \"timeMs\": %lld,\n  \"nodeLimit\": %llu,\n  \"depthLimit\": %d,\n  \"hashMb\": %zu,\n",
+        quote(options.input).c_str(), options.threads, options.time, (unsigned long long)options.nodes, options.depth, options.hash);
+    fprintf(out, "  \"network\": %s,\n  \"positions\": %zu,\n  \"solved\": %d,\n  \"seconds\": %.3f,\n  \"nodes\": %llu,\n  \"nps\": %.0f,\n  \"results\": [\n",
+        Network::instance().loaded() ? "true" : "false", entries.size(), solved, seconds, (unsigned long long)nodes, nodes / std::max(seconds, 1e-9));
+
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        const Outcome& o = e.outcome;
+        Position position = e.puzzle.position;
+
+        fprintf(out, "    { \"id\": %s, \"solved\": %s, \"move\": %s, \"bm\": %s, \"am\": %s, \"depth\": %d, \"nodes\": %llu, \"ms\": %lld, "
+            "\"solvedDepth\": %d, \"solvedNodes\": %llu, \"solvedMs\": %lld }%s\n",
+            quote(e.puzzle.id).c_str(), o.solved ? "true" : "false", o.played == NO_MOVE ? "null" : quote(position.san(o.played)).c_str(),
+            sanList(position, e.puzzle.best).c_str(), sanList(position, e.avoid).c_str(), o.depth, (unsigned long long)o.nodes, o.ms,
+            o.solvedDepth, (unsigned long long)o.solvedNodes, o.solvedMs, i + 1 < entries.size() ? "," : "");
+    }
+
+    fprintf(out, "  ]\n}\n");
+    return fclose(out) == 0;
+}
+
+void usage() {
+    printf("Suite [--threads n] [--time ms] [--nodes n] [--depth n] [--hash mb] [--json path] suite.epd\n");
+    printf("Searches every position of an EPD suite and checks the move against its bm and am opcodes.\n");
+    printf("Positions get %d ms each unless --time, --nodes or --depth says otherwise; --time 0 lifts the time limit.\n", SUITETIME);
+}
+
+//Workers take the next unsolved position until none are left, one search and one table each. The table is cleared for
+//every position, so under a node or depth limit the results do not depend on the thread count
+int main(int argc, char** argv) {
+    Options options = { (int)std::max(1u, std::thread::hardware_concurrency()), -1, 0, SUITEDEPTH, HASHMB, "", "" };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.threads = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+            options.time = std::max(0ll, atoll(argv[++i]));
+        else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            options.nodes = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            options.depth = std::max(1, std::min(SUITEDEPTH, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+            options.hash = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            options.json = argv[++i];
+        else
+            options.input = argv[i];
+    }
+
+    if (options.input.empty()) {
+        usage();
+        return 1;
+    }
+
+    if (options.time < 0)
+        options.time = options.nodes == 0 && options.depth == SUITEDEPTH ? SUITETIME : 0;
+
+    Tablebases::instance().load(TBPATH);
+    Network::instance().load(NNUEPATH);
+
+    std::vector<Entry> entries;
+    int skipped = 0;
+
+    if (!load(options.input, entries, skipped)) {
+        printf("could not read %s\n", options.input.c_str());
+        return 1;
+    }
+
+    if (skipped > 0)
+        printf("%d records without a usable bm or am left out\n", skipped);
+
+    options.threads = std::max(1, std::min(options.threads, (int)entries.size()));
+
+    std::unique_ptr<Slot[]> slots(new Slot[options.threads]);
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> done(false);
+    std::mutex printMutex;
+    std::vector<std::thread> workers;
+    Clock::time_point begin = Clock::now();
+
+    for (int t = 0; t < options.threads; t++) {
+        slots[t].stop = false;
+        slots[t].deadline = -1;
+    }
+
+    std::thread clock([&] {
+        while (!done) {
+            long long now = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+
+            for (int t = 0; t < options.threads; t++) {
+                std::lock_guard<std::mutex> lock(slots[t].mutex);
+
+                if (slots[t].deadline >= 0 && now >= slots[t].deadline)
+                    slots[t].stop = true;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    for (int t = 0; t < options.threads; t++) {
+        workers.push_back(std::thread([&, t] {
+            Search search;
+            TranspositionTable table(options.hash);
+
+            for (std::size_t i = next++; i < entries.size(); i = next++) {
+                Entry& entry = entries[i];
+                entry.outcome = solve(entry, search, table, options, slots[t], begin);
+
+                Position position = entry.puzzle.position;
+                std::lock_guard<std::mutex> lock(printMutex);
+                printf("%-24s %-4s %-8s depth %2d %10llu nodes %7lld ms\n", entry.puzzle.id.c_str(), entry.outcome.solved ? "ok" : "FAIL",
+                    entry.outcome.played == NO_MOVE ? "-" : position.san(entry.outcome.played).c_str(), entry.outcome.depth,
+                    (unsigned long long)entry.outcome.nodes, entry.outcome.ms);
+                fflush(stdout);
+            }
+        }));
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    done = true;
+    clock.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::uint64_t nodes = 0;
+    int solved = 0;
+
+    for (const Entry& e : entries) {
+        nodes += e.outcome.nodes;
+        solved += e.outcome.solved;
+    }
+
+    printf("solved %d/%zu in %.2f s with %d threads, %llu nodes, %.0f nodes/s\n", solved, entries.size(), seconds, options.threads,
+        (unsigned long long)nodes, nodes / std::max(seconds, 1e-9));
+
+    if (!options.json.empty() && !writeJson(options.json, options, entries, solved, nodes, seconds)) {
+        printf("could not write %s\n", options.json.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,313 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Tablebase.hpp"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace Chess {
+    namespace {
+        const char* LETTERS = "KQRBNP";
+        const PieceType TYPES[6] = { King, Queen, Rook, Bishop, Knight, Pawn };
+
+        //The ten squares of the a1-d1-d4 triangle, the only white king squares pawnless tables keep
+        const Square TRIANGLE[10] = { A1, B1, C1, D1, B2, C2, D2, C3, D3, D4 };
+
+        //Bit 0 mirrors the files, bit 1 the ranks and bit 2 swaps files and ranks
+        Square transform(Square s, int symmetry) {
+            if (symmetry & 1)
+                s ^= 7;
+
+            if (symmetry & 2)
+                s ^= 56;
+
+            if (symmetry & 4)
+                s = (fileOf(s) << 3) | rankOf(s);
+
+            return s;
+        }
+
+        int triangleSlot(Square s) {
+            for (int i = 0; i < 10; i++)
+                if (TRIANGLE[i] == s)
+                    return i;
+
+            return -1;
+        }
+
+        std::string sideName(const Position& position, Color c) {
+            std::string text = "K";
+
+            for (int t = 1; t < 6; t++)
+                text.append(popcount(position.pieces(makePiece(c, TYPES[t]))), LETTERS[t]);
+
+            return text;
+        }
+
+        //Every side made of a king plus pieces listed in QRBNP order, at most extra pieces long
+        void sides(std::string prefix, int from, int extra, std::vector<std::string>& out) {
+            out.push_back(prefix);
+
+            if (extra == 0)
+                return;
+
+            for (int t = from; t < 6; t++)
+                sides(prefix + LETTERS[t], t, extra - 1, out);
+        }
+    }
+
+    bool Tablebase::parse(const std::string& signature, std::vector<Piece>& out) {
+        std::size_t split = signature.find('v');
+
+        if (split == std::string::npos || signature[0] != 'K' || signature.size() < split + 2 || signature[split + 1] != 'K')
+            return false;
+
+        std::vector<Piece> rest;
+        out.clear();
+        out.push_back(WhiteKing);
+        out.push_back(BlackKing);
+
+        for (std::size_t i = 1; i < signature.size(); i++) {
+            if (i == split || i == split + 1)
+                continue;
+
+            const char* letter = strchr(LETTERS, signature[i]);
+
+            if (letter == nullptr || *letter == 'K')
+                return false;
+
+            out.push_back(makePiece(i < split ? White : Black, TYPES[letter - LETTERS]));
+        }
+
+        return out.size() <= TBPIECES;
+    }
+
+    std::string Tablebase::name(const Position& position, bool flipped) {
+        Color first = flipped ? Black : White;
+        return sideName(position, first) + "v" + sideName(position, (Color)(first ^ 1));
+    }
+
+    Tablebase::Tablebase(const std::string& name) :
+        signature(name), pawns(false), count(0), values(nullptr)
+    {
+        if (!parse(name, pieces))
+            return;
+
+        for (Piece p : pieces)
+            pawns |= typeOf(p) == Pawn;
+
+        count = 2 * (pawns ? 32 : 10);
+
+        for (std::size_t i = 1; i < pieces.size(); i++)
+            count *= 64;
+    }
+
+    //The header carries a magic, the version, the entry count and the signature, the values follow one byte each
+    bool Tablebase::open(const std::string& path) {
+        if (count == 0 || !file.open(path))
+            return false;
+
+        //A truncated file is turned away before its header is read
+        if (file.data() == nullptr || file.size() != TBHEADER + count) {
+            file.close();
+            return false;
+        }
+
+        const unsigned char* data = file.data();
+        std::uint32_t version;
+        std::uint64_t entries;
+        char stored[17] = {};
+
+        memcpy(&version, data + 4, 4);
+        memcpy(&entries, data + 8, 8);
+        memcpy(stored, data + 16, 16);
+
+        if (memcmp(data, "BMTB", 4) != 0 || version != TBVERSION || entries != count || signature != stored) {
+            file.close();
+            return false;
+        }
+
+        values = data + TBHEADER;
+        return true;
+    }
+
+    bool Tablebase::write(const std::string& path, const std::uint8_t* data) const {
+        unsigned char header[TBHEADER] = {};
+        std::uint32_t version = TBVERSION;
+        std::string temporary = path + ".tmp";
+
+        memcpy(header, "BMTB", 4);
+        memcpy(header + 4, &version, 4);
+        memcpy(header + 8, &count, 8);
+        memcpy(header + 16, signature.c_str(), std::min<std::size_t>(signature.size(), 16));
+
+        FILE* f = fopen(temporary.c_str(), "wb");
+
+        if (f == nullptr)
+            return false;
+
+        bool ok = fwrite(header, 1, TBHEADER, f) == TBHEADER && fwrite(data, 1, (std::size_t)count, f) == count;
+        ok = fclose(f) == 0 && ok;
+
+        remove(path.c_str());
+        return ok && rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    //A king on the a1-h8 diagonal is left in place by the swap, so both orientations are tried and the smaller squares
+    //kept. Identical pieces are sorted, which leaves a single index for each position
+    std::uint64_t Tablebase::index(const Square* squares, Color side) const {
+        int symmetry = fileOf(squares[0]) > 3 ? 1 : 0;
+
+        if (!pawns) {
+            if (rankOf(squares[0]) > 3)
+                symmetry |= 2;
+
+            Square king = transform(squares[0], symmetry);
+
+            if (rankOf(king) > fileOf(king))
+                symmetry |= 4;
+        }
+
+        Square king = transform(squares[0], symmetry);
+        Square best[TBPIECES];
+        int orientations = !pawns && rankOf(king) == fileOf(king) ? 2 : 1;
+
+        for (int o = 0; o < orientations; o++) {
+            Square placed[TBPIECES];
+
+            for (std::size_t p = 1; p < pieces.size(); p++)
+                placed[p] = transform(squares[p], symmetry ^ (o * 4));
+
+            for (std::size_t p = 2; p < pieces.size(); p++)
+                for (std::size_t q = p; q > 1 && pieces[q] == pieces[q - 1] && placed[q] < placed[q - 1]; q--)
+                    std::swap(placed[q], placed[q - 1]);
+
+            if (o == 0 || std::lexicographical_compare(placed + 1, placed + pieces.size(), best + 1, best + pieces.size()))
+                std::copy(placed + 1, placed + pieces.size(), best + 1);
+        }
+
+        std::uint64_t i = (std::uint64_t)side * (pawns ? 32 : 10) + (pawns ? rankOf(king) * 4 + fileOf(king) : triangleSlot(king));
+
+        for (std::size_t p = 1; p < pieces.size(); p++)
+            i = i * 64 + best[p];
+
+        return i;
+    }
+
+    //False for indices that name no position: two pieces on a square or a pawn on the first or last rank
+    bool Tablebase::decode(std::uint64_t index, Square* squares, Color& side) const {
+        Bitboard used = 0;
+
+        for (std::size_t p = pieces.size() - 1; p >= 1; p--) {
+            squares[p] = (Square)(index % 64);
+            index /= 64;
+        }
+
+        int slots = pawns ? 32 : 10;
+        int slot = (int)(index % slots);
+        side = (Color)(index / slots);
+        squares[0] = pawns ? makeSquare(slot % 4, slot / 4) : TRIANGLE[slot];
+
+        for (std::size_t p = 0; p < pieces.size(); p++) {
+            if ((used & bit(squares[p])) || (typeOf(pieces[p]) == Pawn && (rankOf(squares[p]) == 0 || rankOf(squares[p]) == 7)))
+                return false;
+
+            used |= bit(squares[p]);
+        }
+
+        return true;
+    }
+
+    //Squares in layout order, with colors swapped and the board turned upside down for the mirrored material
+    bool Tablebase::squaresOf(const Position& position, bool flipped, Square* squares) const {
+        Bitboard remaining[12];
+
+        for (int p = 0; p < 12; p++)
+            remaining[p] = position.pieces((Piece)p);
+
+        for (std::size_t i = 0; i < pieces.size(); i++) {
+            Piece p = flipped ? makePiece((Color)(colorOf(pieces[i]) ^ 1), typeOf(pieces[i])) : pieces[i];
+
+            if (!remaining[p])
+                return false;
+
+            squares[i] = flipped ? popLsb(remaining[p]) ^ 56 : popLsb(remaining[p]);
+        }
+
+        return true;
+    }
+
+    Tablebases::Tablebases() :
+        largest(2)
+    {}
+
+    Tablebases& Tablebases::instance() {
+        static Tablebases tablebases;
+        return tablebases;
+    }
+
+    //Tries every signature up to TBPIECES pieces, missing files are simply not there to probe
+    int Tablebases::load(const std::string& directory) {
+        std::vector<std::string> names;
+        int loaded = 0;
+
+        sides("K", 1, TBPIECES - 2, names);
+
+        for (const std::string& white : names)
+            for (const std::string& black : names)
+                if (white.size() + black.size() <= TBPIECES && white.size() + black.size() > 2)
+                    loaded += add(white + "v" + black, directory + "/" + white + "v" + black + ".tb");
+
+        return loaded;
+    }
+
+    bool Tablebases::add(const std::string& signature, const std::string& path) {
+        std::unique_ptr<Tablebase> table(new Tablebase(signature));
+
+        if (!table->open(path))
+            return false;
+
+        largest = std::max(largest, (int)table->layout().size());
+        tables[signature] = std::move(table);
+        return true;
+    }
+
+    bool Tablebases::probe(const Position& position, TbResult& result) const {
+        int pieceCount = popcount(position.pieces());
+        Color us = position.sideToMove();
+        Square passant = position.enPassantSquare();
+
+        if (pieceCount > largest || position.castlingRights() != 0)
+            return false;
+
+        //Every double push leaves the square behind, only a pawn that could take there changes the result
+        if (passant != NO_SQUARE && (pawnAttacks((Color)(us ^ 1), passant) & position.pieces(makePiece(us, Pawn))))
+            return false;
+
+        if (pieceCount == 2) {
+            result = tbDecode(TbDraw);
+            return true;
+        }
+
+        for (int flipped = 0; flipped < 2; flipped++) {
+            auto it = tables.find(Tablebase::name(position, flipped != 0));
+            Square squares[TBPIECES];
+
+            if (it == tables.end() || !it->second->squaresOf(position, flipped != 0, squares))
+                continue;
+
+            Color side = flipped ? (Color)(us ^ 1) : us;
+            std::uint8_t value = it->second->value(it->second->index(squares, side));
+
+            if (value == TbIllegal)
+                return false;
+
+            result = tbDecode(value);
+            return true;
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include "Chess.hpp"
+#include "MappedFile.hpp"
+
+#define TBPATH "./Tablebases"
+#define TBPIECES 4
+#define TBVERSION 1
+#define TBHEADER 32
+
+namespace Chess {
+    //Result for the side to move: wdl is 1, 0 or -1 and plies counts the half moves to mate for wins and losses
+    struct TbResult {
+        int wdl;
+        int plies;
+    };
+
+    //One byte per position: positions that cannot occur, draws, then losses and wins with their distance to mate.
+    //Draw is also what a position holds while generation has not resolved it
+    enum : std::uint8_t {
+        TbIllegal = 0,
+        TbDraw = 1,
+        TbLoss = 2,
+        TbWin = 128
+    };
+
+    inline std::uint8_t tbEncode(int wdl, int plies) {
+        return wdl == 0 ? (std::uint8_t)TbDraw : (std::uint8_t)((wdl > 0 ? TbWin : TbLoss) + plies);
+    }
+
+    inline TbResult tbDecode(std::uint8_t value) {
+        TbResult r;
+        r.wdl = value >= TbWin ? 1 : value >= TbLoss ? -1 : 0;
+        r.plies = value >= TbWin ? value - TbWin : value >= TbLoss ? value - TbLoss : 0;
+        return r;
+    }
+
+    //One material signature such as "KQvKR". Pieces are laid out as the two kings, then the other white and black pieces
+    //in QRBNP order. The white king is folded onto a1-d1-d4 by the eight board symmetries, or onto files a-d by the
+    //mirror alone once pawns fix the direction, and every other piece takes one of 64 squares
+    class Tablebase {
+        std::string signature;
+        std::vector<Piece> pieces;
+        bool pawns;
+        std::uint64_t count;
+        const std::uint8_t* values;
+        MappedFile file;
+
+    public:
+        static bool parse(const std::string& signature, std::vector<Piece>& out);
+        static std::string name(const Position& position, bool flipped);
+
+        Tablebase(const std::string& signature);
+
+        bool open(const std::string& path);
+        bool write(const std::string& path, const std::uint8_t* data) const;
+
+        const std::string& name() const { return signature; }
+        const std::vector<Piece>& layout() const { return pieces; }
+        std::uint64_t size() const { return count; }
+
+        std::uint64_t index(const Square* squares, Color side) const;
+        bool decode(std::uint64_t index, Square* squares, Color& side) const;
+        bool squaresOf(const Position& position, bool flipped, Square* squares) const;
+        std::uint8_t value(std::uint64_t index) const { return values[index]; }
+    };
+
+    //Tables are looked up by signature, with colors swapped when only the mirrored material was generated.
+    //Positions with castling rights or an en passant capture on the board are never probed, the tables know neither
+    class Tablebases {
+        std::map<std::string, std::unique_ptr<Tablebase>> tables;
+        int largest;
+
+        Tablebases();
+
+    public:
+        static Tablebases& instance();
+
+        int load(const std::string& directory);
+        bool add(const std::string& signature, const std::string& path);
+        bool has(const std::string& signature) const { return tables.count(signature) != 0; }
+        bool probe(const Position& position, TbResult& result) const;
+        int pieces() const { return largest; }
+    };
+}
@@ -0,0 +1,464 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <vector>
+#include <string>
+#include <set>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Tablebase.hpp"
+#include "FileSystem.hpp"
+
+#define DEFAULTTABLES { "KPvK", "KRvK", "KQvK", "KPvKP" }
+#define MAXPLIES 125
+
+using namespace Chess;
+
+struct Options {
+    int threads;
+    std::string directory;
+    std::vector<std::string> tables;
+};
+
+//Splits [0, count) into one contiguous range per thread
+void parallel(std::uint64_t count, int threads, const std::function<void(std::uint64_t, std::uint64_t)>& work) {
+    std::vector<std::thread> workers;
+    std::uint64_t step = (count + threads - 1) / threads;
+
+    for (int t = 0; t < threads; t++) {
+        std::uint64_t begin = std::min(count, t * step);
+        std::uint64_t end = std::min(count, begin + step);
+        workers.push_back(std::thread(work, begin, end));
+    }
+
+    for (std::size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+int material(const std::string& side) {
+    int total = 0;
+
+    for (char c : side)
+        total += c == 'Q' ? 9 : c == 'R' ? 5 : c == 'B' || c == 'N' ? 3 : c == 'P' ? 1 : 0;
+
+    return total;
+}
+
+//Only one color assignment of each material is generated, the stronger side plays white
+std::string canonical(const std::string& signature) {
+    std::size_t split = signature.find('v');
+    std::string white = signature.substr(0, split);
+    std::string black = signature.substr(split + 1);
+
+    if (material(black) > material(white) || (material(black) == material(white) && black > white))
+        std::swap(white, black);
+
+    return white + "v" + black;
+}
+
+//Every capture and promotion leads into a smaller or different table, those are generated first
+void dependencies(const std::string& signature, std::set<std::string>& seen, std::vector<std::string>& order) {
+    if (!seen.insert(signature).second)
+        return;
+
+    std::size_t split = signature.find('v');
+    std::string sides[2] = { signature.substr(0, split), signature.substr(split + 1) };
+
+    for (int c = 0; c < 2; c++) {
+        for (std::size_t i = 1; i < sides[c].size(); i++) {
+            std::string changed[2] = { sides[0], sides[1] };
+            changed[c].erase(i, 1);
+
+            if (changed[0].size() + changed[1].size() > 2)
+                dependencies(canonical(changed[0] + "v" + changed[1]), seen, order);
+
+            if (sides[c][i] != 'P')
+                continue;
+
+            for (const char* promotion = "QRBN"; *promotion; promotion++) {
+                std::string promoted[2] = { sides[0], sides[1] };
+                promoted[c][i] = *promotion;
+                std::sort(promoted[c].begin() + 1, promoted[c].end(), [](char a, char b) { return strchr("QRBNP", a) < strchr("QRBNP", b); });
+                dependencies(canonical(promoted[0] + "v" + promoted[1]), seen, order);
+            }
+        }
+    }
+
+    order.push_back(signature);
+}
+
+//Retrograde analysis over one table. Every position first looks at its own moves: mates and stalemates are final, and
+//captures and promotions are read from the smaller tables. Then iteration n resolves the positions decided in n plies:
+//for odd n, the predecessors of positions lost in n - 1 are won, for even n a predecessor of a position won in n - 1 is
+//lost once every move inside the table leads to a win for the opponent. Predecessors come from un-moves, so each
+//iteration only touches the positions next to the previous one's results.
+class Generator {
+    enum FLAG : std::uint8_t {
+        DrawExit = 1,
+        Candidate = 2
+    };
+
+    const Tablebase& table;
+    int threads;
+    std::uint64_t count;
+    std::unique_ptr<std::atomic<std::uint8_t>[]> result;
+    std::unique_ptr<std::atomic<std::uint8_t>[]> flags;
+    std::vector<std::uint8_t> exitWin;
+    std::vector<std::uint8_t> exitLoss;
+    std::vector<std::vector<std::uint64_t>> deferred;
+    std::mutex mutex;
+    bool missing;
+
+    bool load(std::uint64_t i, Position& position) const {
+        Square squares[TBPIECES];
+        Color side;
+
+        //Positions reached through a second index are kept once, the other copy is never probed
+        if (!table.decode(i, squares, side) || table.index(squares, side) != i || !position.setup(table.layout().data(), squares, (int)table.layout().size(), side))
+            return false;
+
+        return !position.attacked(position.king((Color)(side ^ 1)), side);
+    }
+
+    static bool leaves(const Position& position, Move m) {
+        return position.pieceOn(toOf(m)) != NO_PIECE || flagOf(m) == Promotion || flagOf(m) == EnPassant;
+    }
+
+    std::uint64_t child(const Position& position) const {
+        Square squares[TBPIECES];
+        table.squaresOf(position, false, squares);
+        return table.index(squares, position.sideToMove());
+    }
+
+    void defer(int plies, std::uint64_t i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        deferred[plies].push_back(i);
+    }
+
+    void classify(std::uint64_t begin, std::uint64_t end) {
+        Position position;
+        MoveList list;
+        Undo undo;
+
+        for (std::uint64_t i = begin; i < end; i++) {
+            exitWin[i] = 0;
+            exitLoss[i] = 0;
+            flags[i] = 0;
+
+            if (!load(i, position)) {
+                result[i] = TbIllegal;
+                continue;
+            }
+
+            position.generate(list);
+
+            if (list.size == 0) {
+                result[i] = position.inCheck() ? tbEncode(-1, 0) : (std::uint8_t)TbDraw;
+                continue;
+            }
+
+            result[i] = TbDraw;
+            bool inside = false;
+
+            for (int m = 0; m < list.size; m++) {
+                if (!leaves(position, list.moves[m])) {
+                    inside = true;
+                    continue;
+                }
+
+                TbResult r;
+                position.make(list.moves[m], undo);
+                bool found = Tablebases::instance().probe(position, r);
+                position.unmake(list.moves[m], undo);
+
+                if (!found) {
+                    missing = true;
+                    continue;
+                }
+
+                if (r.wdl < 0 && (exitWin[i] == 0 || r.plies + 1 < exitWin[i]))
+                    exitWin[i] = (std::uint8_t)std::min(r.plies + 1, 255);
+                else if (r.wdl > 0)
+                    exitLoss[i] = (std::uint8_t)std::max<int>(exitLoss[i], std::min(r.plies + 1, 255));
+                else if (r.wdl == 0)
+                    flags[i] |= DrawExit;
+            }
+
+            //With every move leaving the table and all of them losing, the length is already known
+            if (!inside && exitWin[i] == 0 && !(flags[i] & DrawExit))
+                defer(exitLoss[i], i);
+        }
+    }
+
+    void predecessors(std::uint64_t i, std::vector<std::uint64_t>& out) const {
+        Square squares[TBPIECES];
+        Color side;
+        Bitboard occupied = 0;
+        const std::vector<Piece>& layout = table.layout();
+
+        out.clear();
+        table.decode(i, squares, side);
+
+        Color mover = (Color)(side ^ 1);
+
+        for (std::size_t p = 0; p < layout.size(); p++)
+            occupied |= bit(squares[p]);
+
+        for (std::size_t p = 0; p < layout.size(); p++) {
+            if (colorOf(layout[p]) != mover)
+                continue;
+
+            Square to = squares[p];
+            Bitboard from;
+
+            switch (typeOf(layout[p])) {
+            case Pawn: {
+                int back = mover == White ? -8 : 8;
+                int home = mover == White ? 1 : 6;
+                from = 0;
+
+                if (rankOf(to + back) != 0 && rankOf(to + back) != 7 && !(occupied & bit(to + back))) {
+                    from |= bit(to + back);
+
+                    if (rankOf(to + 2 * back) == home && !(occupied & bit(to + 2 * back)))
+                        from |= bit(to + 2 * back);
+                }
+
+                break;
+            }
+            case Knight: from = knightAttacks(to); break;
+            case Bishop: from = bishopAttacks(to, occupied); break;
+            case Rook: from = rookAttacks(to, occupied); break;
+            case Queen: from = bishopAttacks(to, occupied) | rookAttacks(to, occupied); break;
+            default: from = kingAttacks(to); break;
+            }
+
+            from &= ~occupied;
+
+            while (from) {
+                squares[p] = popLsb(from);
+                out.push_back(table.index(squares, mover));
+            }
+
+            squares[p] = to;
+        }
+    }
+
+    //Exits were already ruled out by the caller, so only the moves that stay in the table are left to check
+    bool allWon(std::uint64_t i) const {
+        Position position;
+        MoveList list;
+        Undo undo;
+
+        load(i, position);
+        position.generate(list);
+
+        for (int m = 0; m < list.size; m++) {
+            if (leaves(position, list.moves[m]))
+                continue;
+
+            position.make(list.moves[m], undo);
+            std::uint8_t value = result[child(position)];
+            position.unmake(list.moves[m], undo);
+
+            if (value < TbWin)
+                return false;
+        }
+
+        return true;
+    }
+
+public:
+    Generator(const Tablebase& tablebase, int threadCount) :
+        table(tablebase), threads(threadCount), count(tablebase.size()),
+        result(new std::atomic<std::uint8_t>[tablebase.size()]), flags(new std::atomic<std::uint8_t>[tablebase.size()]),
+        exitWin(tablebase.size()), exitLoss(tablebase.size()), deferred(256), missing(false)
+    {}
+
+    bool run(std::vector<std::uint8_t>& out, int& longest) {
+        parallel(count, threads, [this](std::uint64_t begin, std::uint64_t end) { classify(begin, end); });
+
+        if (missing)
+            return false;
+
+        int lastChange = 0;
+        int lastExit = 0;
+
+        for (std::uint64_t i = 0; i < count; i++)
+            lastExit = std::max<int>(lastExit, exitWin[i]);
+
+        for (int p = 0; p < (int)deferred.size(); p++)
+            if (!deferred[p].empty())
+                lastExit = std::max(lastExit, p);
+
+        for (int n = 1; n <= lastChange + 2 || n <= lastExit; n++) {
+            if (n > MAXPLIES)
+                return false;
+
+            bool odd = (n & 1) != 0;
+            std::uint8_t previous = tbEncode(odd ? -1 : 1, n - 1);
+            std::uint8_t won = tbEncode(1, n);
+            std::uint8_t lost = tbEncode(-1, n);
+            std::atomic<std::uint64_t> changed(0);
+
+            parallel(count, threads, [&](std::uint64_t begin, std::uint64_t end) {
+                std::vector<std::uint64_t> before;
+                std::uint64_t local = 0;
+
+                for (std::uint64_t i = begin; i < end; i++) {
+                    if (result[i] != previous)
+                        continue;
+
+                    predecessors(i, before);
+
+                    for (std::uint64_t p : before) {
+                        if (result[p] != TbDraw)
+                            continue;
+
+                        if (odd) {
+                            result[p] = won;
+                            local++;
+                        }
+                        else if (exitWin[p] == 0 && !(flags[p] & DrawExit)) {
+                            flags[p] |= Candidate;
+                        }
+                    }
+                }
+
+                changed += local;
+            });
+
+            parallel(count, threads, [&](std::uint64_t begin, std::uint64_t end) {
+                std::uint64_t local = 0;
+
+                for (std::uint64_t i = begin; i < end; i++) {
+                    if (result[i] != TbDraw)
+                        continue;
+
+                    if (odd && exitWin[i] == n) {
+                        result[i] = won;
+                        local++;
+                    }
+                    else if (!odd && (flags[i] & Candidate)) {
+                        flags[i] &= (std::uint8_t)~Candidate;
+
+                        if (!allWon(i))
+                            continue;
+
+                        if (exitLoss[i] <= n) {
+                            result[i] = lost;
+                            local++;
+                        }
+                        else {
+                            defer(exitLoss[i], i);
+                        }
+                    }
+                }
+
+                changed += local;
+            });
+
+            if (!odd) {
+                for (std::uint64_t i : deferred[n]) {
+                    if (result[i] == TbDraw) {
+                        result[i] = lost;
+                        changed++;
+                    }
+                }
+            }
+
+            if (changed > 0)
+                lastChange = n;
+        }
+
+        out.resize((std::size_t)count);
+        longest = lastChange;
+
+        for (std::uint64_t i = 0; i < count; i++)
+            out[(std::size_t)i] = result[i];
+
+        return true;
+    }
+};
+
+int main(int argc, char** argv) {
+    Options options = { (int)std::max(1u, std::thread::hardware_concurrency()), TBPATH, {} };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.threads = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            options.directory = argv[++i];
+        else
+            options.tables.push_back(argv[i]);
+    }
+
+    if (options.tables.empty())
+        options.tables = DEFAULTTABLES;
+
+    std::set<std::string> seen;
+    std::vector<std::string> order;
+
+    for (const std::string& name : options.tables) {
+        std::vector<Piece> layout;
+
+        if (!Tablebase::parse(name, layout)) {
+            printf("%s is not a table of at most %d pieces\n", name.c_str(), TBPIECES);
+            return 1;
+        }
+
+        dependencies(canonical(name), seen, order);
+    }
+
+    FileSystem::makeDirectory(options.directory);
+    Tablebases& tablebases = Tablebases::instance();
+    tablebases.load(options.directory);
+
+    for (const std::string& name : order) {
+        if (tablebases.has(name)) {
+            printf("%-8s already in %s\n", name.c_str(), options.directory.c_str());
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        Tablebase table(name);
+        Generator generator(table, options.threads);
+        std::vector<std::uint8_t> values;
+        std::string path = options.directory + "/" + name + ".tb";
+        int longest = 0;
+
+        if (!generator.run(values, longest)) {
+            printf("%s could not be generated\n", name.c_str());
+            return 1;
+        }
+
+        if (!table.write(path, values.data()) || !tablebases.add(name, path)) {
+            printf("could not write %s\n", path.c_str());
+            return 1;
+        }
+
+        std::uint64_t wins = 0, draws = 0, losses = 0;
+
+        for (std::uint8_t v : values) {
+            wins += v >= TbWin;
+            losses += v >= TbLoss && v < TbWin;
+            draws += v == TbDraw;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%-8s %10llu positions: %llu won, %llu drawn, %llu lost, longest mate %d plies, %.1f s\n", name.c_str(),
+            (unsigned long long)values.size(), (unsigned long long)wins, (unsigned long long)draws, (unsigned long long)losses, longest, seconds);
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,387 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "Search.hpp"
+#include "Tablebase.hpp"
+
+#define ENGINENAME "BestMove"
+#define ENGINEAUTHOR "BestMove developers"
+#define HASHMAX 4096
+#define THREADSMAX 64
+#define LINESMAX 16
+#define MOVESLEFT 30
+#define MOVEOVERHEAD 30
+
+using namespace Chess;
+
+typedef std::chrono::steady_clock Clock;
+
+//What one go command asked for. Times are in milliseconds, -1 where the GUI gave none
+struct GoLimits {
+    int depth;
+    std::uint64_t nodes;
+    long long movetime;
+    long long time[2];
+    long long increment[2];
+    int movesToGo;
+    bool infinite;
+
+    GoLimits() :
+        depth(MAXPLY - 1), nodes(0), movetime(-1), time{ -1, -1 }, increment{ 0, 0 }, movesToGo(0), infinite(false)
+    {}
+};
+
+//Scores from the side to move's view, mates as the number of moves, negative when the side to move is mated
+std::string scoreText(int score) {
+    if (!isMateDistance(score))
+        return "cp " + std::to_string(score);
+
+    int moves = (MATE - std::abs(score) + 1) / 2;
+    return "mate " + std::to_string(score > 0 ? moves : -moves);
+}
+
+//The engine reads commands on the main thread while a search runs on its own, so stop, quit and isready are answered
+//at once. The search polls the stop flag at every node, which ends it well within a millisecond. With more than one
+//thread, helpers search the same position and share the table, the main thread's result is the one reported
+class Engine {
+    Position position;
+    std::vector<std::uint64_t> history;
+    TranspositionTable table;
+    int threads;
+    int lines;
+    std::thread searcher;
+    std::atomic<bool> stop;
+    std::atomic<bool> helpersStop;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool finished;
+    std::mutex output;
+
+    void say(const std::string& line);
+    void wait();
+    void halt();
+    void setOption(std::istringstream& in);
+    void setPosition(std::istringstream& in);
+    void go(std::istringstream& in);
+    void think(GoLimits go);
+
+public:
+    Engine();
+
+    void loop();
+};
+
+Engine::Engine() :
+    table(HASHMB), threads(1), lines(1), stop(false), helpersStop(false), finished(true)
+{
+    position.fromFen(STARTFEN);
+}
+
+void Engine::say(const std::string& line) {
+    std::lock_guard<std::mutex> lock(output);
+    printf("%s\n", line.c_str());
+    fflush(stdout);
+}
+
+void Engine::wait() {
+    if (searcher.joinable())
+        searcher.join();
+}
+
+void Engine::halt() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+    wake.notify_all();
+}
+
+//Hash and Threads only change between searches, a GUI sends them before go
+void Engine::setOption(std::istringstream& in) {
+    std::string token, name, value;
+    in >> token;
+
+    while (in >> token && token != "value")
+        name += (name.empty() ? "" : " ") + token;
+
+    in >> value;
+    wait();
+
+    if (name == "Hash")
+        table.resize(std::max(1, std::min(HASHMAX, atoi(value.c_str()))));
+    else if (name == "Threads")
+        threads = std::max(1, std::min(THREADSMAX, atoi(value.c_str())));
+    else if (name == "MultiPV")
+        lines = std::max(1, std::min(LINESMAX, atoi(value.c_str())));
+    else
+        say("info string unknown option " + name);
+}
+
+//position startpos|fen <fen> [moves <uci>...]. A move that is not legal ends the list where it stands. The keys of the
+//positions the moves pass through let the search see repetitions of the game
+void Engine::setPosition(std::istringstream& in) {
+    std::string token, fen;
+    in >> token;
+
+    if (token == "startpos") {
+        fen = STARTFEN;
+        in >> token;
+    }
+    else if (token == "fen") {
+        while (in >> token && token != "moves")
+            fen += (fen.empty() ? "" : " ") + token;
+    }
+
+    wait();
+    Position next;
+
+    if (!next.fromFen(fen)) {
+        say("info string invalid position " + fen);
+        return;
+    }
+
+    Undo undo;
+    std::vector<std::uint64_t> keys;
+
+    while (in >> token) {
+        Move m = next.parseUci(token);
+
+        if (m == NO_MOVE) {
+            say("info string illegal move " + token);
+            break;
+        }
+
+        keys.push_back(next.key());
+        next.make(m, undo);
+    }
+
+    position = next;
+    history.swap(keys);
+}
+
+void Engine::go(std::istringstream& in) {
+    GoLimits limits;
+    std::string token;
+
+    while (in >> token) {
+        if (token == "depth")
+            in >> limits.depth;
+        else if (token == "nodes")
+            in >> limits.nodes;
+        else if (token == "movetime")
+            in >> limits.movetime;
+        else if (token == "wtime")
+            in >> limits.time[White];
+        else if (token == "btime")
+            in >> limits.time[Black];
+        else if (token == "winc")
+            in >> limits.increment[White];
+        else if (token == "binc")
+            in >> limits.increment[Black];
+        else if (token == "movestogo")
+            in >> limits.movesToGo;
+        else if (token == "infinite")
+            limits.infinite = true;
+    }
+
+    limits.depth = std::max(1, std::min(MAXPLY - 1, limits.depth));
+    wait();
+    stop = false;
+    helpersStop = false;
+    finished = false;
+    searcher = std::thread(&Engine::think, this, limits);
+}
+
+//A fixed time per move when the GUI gives one. Otherwise a share of the clock over the moves to the next time control
+//plus most of the increment, and no new iteration once half of that is used, since it would rarely finish
+void Engine::think(GoLimits go) {
+    Clock::time_point start = Clock::now();
+    Color side = position.sideToMove();
+    long long budget = go.movetime;
+    bool clock = false;
+
+    if (budget < 0 && go.time[side] >= 0) {
+        long long time = go.time[side];
+        budget = time / (go.movesToGo > 0 ? go.movesToGo : MOVESLEFT) + go.increment[side] * 3 / 4;
+        budget = std::max(1ll, std::min(budget, time - MOVEOVERHEAD));
+        clock = true;
+    }
+
+    if (go.infinite)
+        budget = -1;
+
+    table.age();
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> helperNodes(new std::atomic<std::uint64_t>[threads]);
+    std::vector<std::thread> helpers;
+
+    for (int t = 1; t < threads; t++) {
+        helperNodes[t] = 0;
+        helpers.push_back(std::thread([this, t, &helperNodes] {
+            Search search;
+            SearchLimits limits;
+            limits.stop = &helpersStop;
+            limits.table = &table;
+            limits.history = history;
+            limits.iteration = [t, &helperNodes](const SearchResult& r) { helperNodes[t] = r.nodes; };
+            SearchResult result = search.run(position, limits);
+            helperNodes[t] = result.nodes;
+        }));
+    }
+
+    auto elapsed = [start] {
+        return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    };
+
+    auto counted = [&](std::uint64_t main) {
+        for (int t = 1; t < threads; t++)
+            main += helperNodes[t];
+
+        return main;
+    };
+
+    //Only the clock thread waits on the budget, the search itself just polls stop
+    std::thread timer([&] {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (budget >= 0 && !wake.wait_until(lock, start + std::chrono::milliseconds(budget), [this] { return finished || stop.load(); }))
+            stop = true;
+    });
+
+    Search search;
+    SearchLimits limits;
+    limits.depth = go.depth;
+    limits.nodes = go.nodes;
+    limits.lines = lines;
+    limits.stop = &stop;
+    limits.table = &table;
+    limits.history = history;
+    limits.iteration = [&](const SearchResult& r) {
+        long long ms = elapsed();
+        std::uint64_t nodes = counted(r.nodes);
+
+        for (std::size_t k = 0; k < r.lines.size(); k++) {
+            std::ostringstream info;
+            info << "info depth " << r.depth;
+
+            if (lines > 1)
+                info << " multipv " << k + 1;
+
+            info << " score " << scoreText(r.lines[k].score) << " nodes " << nodes << " nps " << nodes * 1000 / std::max(1ll, ms)
+                << " hashfull " << table.hashfull() << " time " << ms << " pv";
+
+            for (Move m : r.lines[k].pv)
+                info << " " << uci(m);
+
+            say(info.str());
+        }
+
+        if (clock && budget >= 0 && ms * 2 > budget)
+            stop = true;
+    };
+
+    SearchResult result = search.run(position, limits);
+
+    //A GUI that said infinite expects no bestmove before its stop
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished = true;
+        wake.notify_all();
+
+        if (go.infinite)
+            wake.wait(lock, [this] { return stop.load(); });
+    }
+
+    timer.join();
+    helpersStop = true;
+
+    for (std::thread& helper : helpers)
+        helper.join();
+
+    long long ms = elapsed();
+    std::uint64_t nodes = counted(result.nodes);
+    say("info nodes " + std::to_string(nodes) + " nps " + std::to_string(nodes * 1000 / std::max(1ll, ms)) + " hashfull " +
+        std::to_string(table.hashfull()) + " time " + std::to_string(ms));
+
+    //Stopped before the first iteration finished there is still a legal move to give
+    Move best = result.best;
+
+    if (best == NO_MOVE) {
+        MoveList legal;
+        Position root = position;
+        root.generate(legal);
+        best = legal.size > 0 ? legal.moves[0] : NO_MOVE;
+    }
+
+    std::string line = "bestmove " + (best == NO_MOVE ? std::string("0000") : uci(best));
+
+    if (result.best != NO_MOVE && result.pv.size() > 1)
+        line += " ponder " + uci(result.pv[1]);
+
+    say(line);
+}
+
+void Engine::loop() {
+    std::string text;
+
+    while (std::getline(std::cin, text)) {
+        std::istringstream in(text);
+        std::string command;
+        in >> command;
+
+        if (command == "uci") {
+            say("id name " ENGINENAME);
+            say("id author " ENGINEAUTHOR);
+            say("option name Hash type spin default " + std::to_string(HASHMB) + " min 1 max " + std::to_string(HASHMAX));
+            say("option name Threads type spin default 1 min 1 max " + std::to_string(THREADSMAX));
+            say("option name MultiPV type spin default 1 min 1 max " + std::to_string(LINESMAX));
+            say("uciok");
+        }
+        else if (command == "isready") {
+            say("readyok");
+        }
+        else if (command == "setoption") {
+            setOption(in);
+        }
+        else if (command == "ucinewgame") {
+            wait();
+            table.clear();
+        }
+        else if (command == "position") {
+            setPosition(in);
+        }
+        else if (command == "go") {
+            go(in);
+        }
+        else if (command == "stop") {
+            halt();
+            wait();
+        }
+        else if (command == "quit") {
+            break;
+        }
+        else if (!command.empty()) {
+            say("info string unknown command " + command);
+        }
+    }
+
+    halt();
+    wait();
+}
+
+int main() {
+    Tablebases::instance().load(TBPATH);
+    Network::instance().load(NNUEPATH);
+
+    Engine engine;
+    engine.loop();
+    return 0;
+}